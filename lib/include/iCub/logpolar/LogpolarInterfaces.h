@@ -27,12 +27,34 @@
 #define __LOGPOLARINTERFACES__
 
 /* dev drivers */
+#include <yarp/os/Bottle.h>
+#include <yarp/os/PortablePair.h>
+#include <yarp/os/Stamp.h>
+#include <yarp/sig/Image.h>
 #include <yarp/dev/FrameGrabberInterfaces.h>
 
 /* LATER: is it likely that some of these would move into iCub::dev namespace? */
 namespace yarp{
     namespace dev {
         class ILogpolarFrameGrabberImage;
+        class ILogpolarImageLender;
+        class LogpolarImageView;
+        class ILogpolarImageBorrow;
+        struct LogpolarGeometry;
+        class ILogpolarGeometry;
+        class ILogpolarReconstruction;
+        class ILogpolarBundle;
+
+        /**
+         * \ingroup logpolarLibrary
+         *
+         * The message of the combined stream of a logpolar grabber: the head is the geometry
+         * (necc nang fovea overlap width height, as in the reply to [get] [geom]), the body
+         * carries the logpolar image (head) and the foveal image (body) sampled from the 
+         * same buffer. The three travel together with a single envelope.
+         */
+        typedef yarp::os::PortablePair<yarp::os::Bottle, 
+            yarp::os::PortablePair<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::sig::ImageOf<yarp::sig::PixelRgb> > > LogpolarBundle;
     }
 }
 
@@ -41,6 +63,7 @@ namespace yarp{
 #define VOCAB_NANG VOCAB4('n','a','n','g')
 #define VOCAB_FOVEA VOCAB3('f','o','v')
 #define VOCAB_OVERLAP VOCAB3('o','v','l')
+#define VOCAB_GEOMETRY VOCAB4('g','e','o','m')
 
 /**
  * \ingroup logpolarLibrary
@@ -90,4 +113,211 @@ public:
     virtual bool getFovealImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) = 0;
 };
 
+/**
+ * \ingroup logpolarLibrary
+ *
+ * The owner of the buffers lent through a LogpolarImageView, e.g. a port reader.
+ */
+class yarp::dev::ILogpolarImageLender {
+public:
+    virtual ~ILogpolarImageLender() {}
+
+    /**
+     * give a buffer back to its owner, called when the last view of the buffer is dropped.
+     * @param key identifies the buffer.
+     */
+    virtual void releaseImage(void *key) = 0;
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * A reference counted view of an image owned by somebody else (e.g. the receive buffer 
+ * of a port). Copies of the view refer to the same image, which is given back to 
+ * its owner when the last copy is dropped or released. The image is not to be 
+ * modified and the views must be dropped before closing the device that lent 
+ * the image. A view and its copies are meant to be used by a single thread.
+ */
+class yarp::dev::LogpolarImageView {
+private:
+    ILogpolarImageLender *lender;
+    void *key;
+    const yarp::sig::ImageOf<yarp::sig::PixelRgb> *img;
+    int *refs;
+
+public:
+    /**
+     * constructor, an empty view.
+     */
+    LogpolarImageView() : lender(0), key(0), img(0), refs(0) {}
+
+    /**
+     * copy constructor, shares the image.
+     */
+    LogpolarImageView(const LogpolarImageView& v) : lender(v.lender), key(v.key), img(v.img), refs(v.refs) {
+        if (refs) (*refs)++;
+    }
+
+    /**
+     * destructor, releases the image if this is the last view.
+     */
+    ~LogpolarImageView() {
+        release();
+    }
+
+    /**
+     * assignment, shares the image.
+     */
+    LogpolarImageView& operator=(const LogpolarImageView& v) {
+        if (this != &v) {
+            if (v.refs) (*v.refs)++;
+            release();
+            lender = v.lender;
+            key = v.key;
+            img = v.img;
+            refs = v.refs;
+        }
+        return *this;
+    }
+
+    /**
+     * make the view refer to a buffer (used by the lender).
+     * @param l is the owner of the buffer.
+     * @param k identifies the buffer with the owner.
+     * @param i is the image.
+     */
+    void attach(ILogpolarImageLender *l, void *k, const yarp::sig::ImageOf<yarp::sig::PixelRgb> *i) {
+        release();
+        lender = l;
+        key = k;
+        img = i;
+        refs = new int(1);
+    }
+
+    /**
+     * drop the view, the image is given back to its owner if this was the last view.
+     */
+    void release() {
+        if (refs && --(*refs) == 0) {
+            delete refs;
+            if (lender) lender->releaseImage(key);
+        }
+        lender = 0;
+        key = 0;
+        img = 0;
+        refs = 0;
+    }
+
+    /**
+     * check whether the view refers to an image.
+     * @return true iff the view is not empty.
+     */
+    bool isValid() const { return img != 0; }
+
+    /**
+     * get the image.
+     * @return a reference to the image (the view must be valid).
+     */
+    const yarp::sig::ImageOf<yarp::sig::PixelRgb>& image() const { return *img; }
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * Access to the logpolar and foveal images without copies: the images are lent
+ * to the caller through a LogpolarImageView.
+ */
+class yarp::dev::ILogpolarImageBorrow {
+public:
+    virtual ~ILogpolarImageBorrow() {}
+
+    /**
+     * borrow the next logpolar image.
+     * @param view refers to the image on return.
+     * @return true iff successful.
+     */
+    virtual bool borrowLogpolarImage(LogpolarImageView& view) = 0;
+
+    /**
+     * borrow the next foveal image.
+     * @param view refers to the image on return.
+     * @return true iff successful.
+     */
+    virtual bool borrowFovealImage(LogpolarImageView& view) = 0;
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * The geometry of a logpolar grabber: the logpolar image and the sensor it is sampled from.
+ * This is the content of the reply to [get] [geom], after [is] [geom].
+ */
+struct yarp::dev::LogpolarGeometry {
+    int necc;           /**< number of eccentricities (rows of the logpolar image) */
+    int nang;           /**< number of angles (columns of the logpolar image) */
+    int fovea;          /**< size of the foveal image (square) */
+    double overlap;     /**< overlap between receptive fields */
+    int width;          /**< width of the cartesian image the logpolar image is sampled from */
+    int height;         /**< height of the cartesian image the logpolar image is sampled from */
+
+    LogpolarGeometry() : necc(0), nang(0), fovea(0), overlap(0.), width(0), height(0) {}
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * Access to the whole geometry of a logpolar grabber at once.
+ */
+class yarp::dev::ILogpolarGeometry {
+public:
+    virtual ~ILogpolarGeometry() {}
+
+    /**
+     * get the geometry of the logpolar images.
+     * @param g is filled with the geometry.
+     * @return true iff successful.
+     */
+    virtual bool getGeometry(LogpolarGeometry& g) = 0;
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * Cartesian images reconstructed from the logpolar stream by the device itself.
+ */
+class yarp::dev::ILogpolarReconstruction {
+public:
+    virtual ~ILogpolarReconstruction() {}
+
+    /**
+     * get the next logpolar image remapped to cartesian.
+     * @param image is the reconstructed RGB image, resized to w by h.
+     * @param w is the width of the reconstruction, zero or negative for the width of the sensor.
+     * @param h is the height of the reconstruction, zero or negative for the height of the sensor.
+     * @return true iff successful.
+     */
+    virtual bool getCartesianReconstruction(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, int w = 0, int h = 0) = 0;
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * Paired logpolar and foveal images, both sampled from the same acquired buffer.
+ */
+class yarp::dev::ILogpolarBundle {
+public:
+    virtual ~ILogpolarBundle() {}
+
+    /**
+     * get the next logpolar image together with the fovea of the same frame.
+     * @param lp is the RGB image containing the logpolar subsampled image.
+     * @param fovea is the RGB image containing the foveal image.
+     * @param stamp is the time stamp of the acquired buffer, shared by the two images.
+     * @return true iff successful.
+     */
+    virtual bool getLogpolarBundle(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
+                                   yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea, 
+                                   yarp::os::Stamp& stamp) = 0;
+};
+
 #endif /* __LOGPOLARINTERFACES__ */
@@ -45,8 +45,10 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <yarp/sig/Image.h>
+#include <yarp/os/Semaphore.h>
 
 /**
  * \file RC_DIST_FB_logpolar_mapper.h \brief The Log Polar library contains the functions
@@ -70,6 +72,17 @@ namespace iCub {
             ELLIPTICAL = 2 /** \def ELLIPTICAL Each receptive field in fovea will be tangent to all its neighbors, having then an elliptical shape. */
         };
 
+        enum {
+            SAMPLED = 0, /** \def SAMPLED The coverage of the receptive fields is estimated on a grid of points (up to ten per pixel along each axis). */
+            ANALYTIC = 1 /** \def ANALYTIC The coverage of the receptive fields is the exact area of each pixel they cover. */
+        };
+
+        enum {
+            PAGES_DEFAULT = 0, /** \def PAGES_DEFAULT The lookup tables are allocated on the heap. */
+            PAGES_TRANSPARENT = 1, /** \def PAGES_TRANSPARENT The lookup tables are aligned to and advised for transparent huge pages (Linux). */
+            PAGES_HUGE = 2 /** \def PAGES_HUGE The lookup tables are allocated on the reserved huge pages, transparent ones if none is available (Linux). */
+        };
+
         enum {
            C2L = 1,     // 2^0
            L2C = 2,     // 2^1
@@ -106,6 +119,63 @@ namespace iCub {
                                  field (i.e. the value will be \p 3*(\p y*xize+x) ).*/
         };
 
+        /**
+         * \struct foveaBlendMask
+         * \brief The precomputed blend of a full resolution fovea into the centre of a cartesian 
+         * reconstruction. The fovea is scaled by nearest neighbour and faded into the 
+         * reconstruction along its border.
+         *
+         */
+        struct foveaBlendMask
+        {
+            int x0;         /**< Column of the cartesian image where the fovea starts (might be negative). */
+            int y0;         /**< Row of the cartesian image where the fovea starts (might be negative). */
+            int size;       /**< Side of the fovea in the cartesian image. */
+            int fovea;      /**< Side of the foveal image. */
+            int *xs;        /**< Column of the foveal image for each column of the fovea in the cartesian image. */
+            int *ys;        /**< Row of the foveal image for each row of the fovea in the cartesian image. */
+            int *alpha;     /**< Weight of the fovea (0 to 256) for each pixel of the fovea in the cartesian image. */
+
+            foveaBlendMask() : x0(0), y0(0), size(0), fovea(0), xs(0), ys(0), alpha(0) {}
+        };
+
+        /**
+         * \struct logpolarPackedTables
+         * \brief The look-up tables of a geometry flattened into plain arrays, e.g. to be saved
+         * or compiled into a program. Positions and taps are byte offsets into images whose
+         * rows are padded to YARP_IMAGE_ALIGN.
+         *
+         */
+        struct logpolarPackedTables
+        {
+            std::vector<unsigned int> c2lOffset;    /**< For each log polar pixel the index of its first cartesian pixel, plus the total. */
+            std::vector<int> c2lPosition;           /**< The position of each cartesian pixel (in bytes). */
+            std::vector<int> c2lWeight;             /**< The weight of each cartesian pixel. */
+            std::vector<int> l2cSpan;               /**< For each row, the first and one past the last column covered by the log polar image. */
+            std::vector<int> l2cRow;                /**< For each row, the index of its first covered pixel, plus the total. */
+            std::vector<unsigned int> l2cOffset;    /**< For each covered pixel the index of its first tap, plus the total. */
+            std::vector<unsigned int> l2cTaps;      /**< The position of each log polar pixel remapped (in bytes). */
+        };
+
+        /**
+         * compute the blend of a fovea into a cartesian reconstruction.
+         * @param mask is the blend, the memory allocated previously is freed.
+         * @param w is the width of the cartesian reconstruction.
+         * @param h is the height of the cartesian reconstruction.
+         * @param fovea is the side of the foveal image.
+         * @param scale is the size of a pixel of the foveal image in the reconstruction (e.g. the
+         * ratio of the reconstruction size and of the size of the image the logpolar image is sampled from).
+         * @param border is the width in pixels of the fading border (in the reconstruction).
+         * @return true iff successful.
+         */
+        bool allocFoveaBlendMask(foveaBlendMask& mask, int w, int h, int fovea, double scale, int border);
+
+        /**
+         * free the memory of a fovea blend.
+         * @param mask is the blend.
+         */
+        void freeFoveaBlendMask(foveaBlendMask& mask);
+
         /**
          * replicate borders on a logpolar image before filtering (similar in spirit to IPP or OpenCV replication).
          * @param dest is the image with replicated borders of size w+2*maxkernelsize, h+maxkernelsize
@@ -122,6 +192,13 @@ namespace iCub {
          * @return true iff the image sizes are compatible with the operation requested
          */
         bool subsampleFovea(yarp::sig::ImageOf<yarp::sig::PixelRgb>& dst, const yarp::sig::ImageOf<yarp::sig::PixelRgb>& src);
+
+        /**
+         * the instruction set the conversions are running with, picked for the host among the
+         * ones the library is built for (the LOGPOLAR_KERNELS environment variable forces one).
+         * @return one of "avx512", "avx2", "sse2", "neon" or "generic".
+         */
+        const char *kernelInstructionSet();
     } // end namespace logpolar
 } // end namespace iCub
 
@@ -134,7 +211,21 @@ namespace iCub {
 class iCub::logpolar::logpolarTransform {
 private:
     cart2LpPixel *c2lTable;
-    lp2CartPixel *l2cTable;
+    bool c2lPacked_;            // whether the C2L table is packed in one block of table pages.
+    cart2LpPixel **c2lReplica_; // the copies of the packed C2L table, one per NUMA node.
+    int nReplicas_;
+    unsigned int *l2cOffset;    // for each covered pixel (row by row), the index of its first tap, plus the total.
+    unsigned short *l2cTaps16;  // the taps (offsets into the logpolar image), when they fit 16 bits.
+    unsigned int *l2cTaps32;    // the taps otherwise, only one of the two is allocated.
+    int *l2cSpan;               // for each row, the first and one past the last column covered by the logpolar image.
+    int *l2cRow;                // for each row, the index of the entry of its first covered pixel.
+    bool l2cPaged_;             // whether the offsets and the taps are on table pages.
+    bool clear_;                // whether the uncovered pixels are cleared by the L2C conversion.
+    int coverage_;              // how the tables are built, SAMPLED or ANALYTIC.
+    bool placeholder_;          // whether the tables are the placeholder of an asynchronous build.
+    bool lazy_;                 // whether the rings of the C2L table are built on first access.
+    int pages_;                 // where the tables are placed, one of the PAGES_ values.
+    bool numa_;                 // whether the C2L table is replicated on each NUMA node.
     int necc_;
     int nang_;
     int width_;
@@ -149,6 +240,27 @@ private:
     */
     double overlap_;
 
+    // the geometry of the receptive fields, the pixels they cover and the scratch memory 
+    // of the table builds (defined by the implementation).
+    struct buildArena;
+    struct rfGeometry;
+    struct rfCoverage;
+
+    // the asynchronous build of the exact tables (defined by the implementation).
+    class AsyncBuilder;
+    friend class AsyncBuilder;
+    AsyncBuilder *async_;
+
+    // lazy C2L table: the geometry of the rings not built yet, the flags of the rings and their
+    // locks, the number of rings left (under ringMutex_) and whether all of them are built (read
+    // without any lock once set).
+    rfGeometry *lazyGeometry_;
+    bool *ringBuilt_;
+    yarp::os::Semaphore *ringLock_;
+    int ringsLeft_;
+    int allRingsBuilt_;
+    yarp::os::Semaphore ringMutex_;
+
     // forbid copies.
     logpolarTransform(const logpolarTransform& x);
     void operator=(const logpolarTransform& x);
@@ -164,28 +276,90 @@ private:
     void RCdeAllocateL2CTable ();
 
     /**
-    * \brief Generates the look-up table for the transformation from a cartesian image to a log polar one, both images are color images
+    * \brief Computes the geometry of the receptive fields, shared by the look-up tables
+    * @param g is the geometry
     * @param scaleFact the ratio between the size of the smallest logpolar pixel and the cartesian ones
     * @param mode is one of the following : RADIAL, TANGENTIAL or ELLIPTICAL
-    * @param padding is the input image row byte padding (cartesian image paddind)
     * @return 0 when there are no errors
     * @return 1 in case of wrong parameters
     * @return 2 in case of allocation problems
     */
-    int RCbuildC2LMap (double scaleFact, int mode, int padding);
+    int RCcomputeRFGeometry (rfGeometry& g, double scaleFact, int mode);
+
+    /**
+    * \brief Copies the C2L table into one block of table pages, exactly sized
+    * @param node is the NUMA node the block is bound to, -1 for any
+    * @return the packed table, 0 in case of allocation problems
+    */
+    cart2LpPixel *RCpackC2LTable (int node);
+
+    /**
+    * \brief Moves the tables on huge pages and replicates the C2L table on the NUMA nodes, as requested
+    * @return true iff successful, the tables are left where they are otherwise
+    */
+    bool RCplaceTables ();
+
+    /**
+    * \brief Selects the copy of the C2L table local to the calling thread
+    * @return the replica of the node the thread is running on, or the C2L table
+    */
+    cart2LpPixel *RCnodeTable ();
+
+    /**
+    * \brief Generates coarse look-up tables: each receptive field takes the pixel at its center
+    * and each pixel the closest receptive field
+    * @param g is the geometry of the receptive fields
+    * @param mode is one of C2L, L2C or BOTH
+    * @param c2lPadding is the input image row byte padding (cartesian image paddind)
+    * @param l2cPadding is the number of pad bytes of the input image (logpolar)
+    * @return 0 when there are no errors
+    * @return 2 in case of allocation problems
+    */
+    int RCbuildPlaceholderMaps (const rfGeometry& g, int mode, int c2lPadding, int l2cPadding);
+
+    /**
+    * \brief Generates the look-up table for the transformation from a cartesian image to a log polar one, both images are color images
+    * @param g is the geometry of the receptive fields
+    * @param padding is the input image row byte padding (cartesian image paddind)
+    * @param cov if not null, receives the pixels covered by each receptive field
+    * @param scratch serves the temporaries of the build
+    * @return 0 when there are no errors
+    * @return 2 in case of allocation problems
+    */
+    int RCbuildC2LMap (const rfGeometry& g, int padding, rfCoverage *cov, buildArena& scratch);
+
+    /**
+    * \brief Generates the entries of one ring of the C2L look-up table
+    * @param g is the geometry of the receptive fields
+    * @param rho is the ring
+    * @param padding is the input image row byte padding (cartesian image paddind)
+    * @param cov if not null, receives the pixels covered by each receptive field of the ring
+    * @param scratch serves the temporaries of the ring, which are given back at the end
+    * @return 0 when there are no errors
+    * @return 2 in case of allocation problems
+    */
+    int RCbuildC2LRing (const rfGeometry& g, int rho, int padding, rfCoverage *cov, buildArena& scratch);
+
+    /**
+    * \brief Computes the scratch memory needed by the build of a ring of the C2L table
+    * @param lim is the half side of the bounding box of the receptive fields of the ring
+    * @return the size in bytes
+    */
+    int RCringScratchSize (int lim);
 
     /**
     * \brief Generates the look-up table for the transformation from a log polar image to a cartesian one.
-    * @param scaleFact the ratio between the size of the smallest logpolar pixel and the cartesian ones
+    * @param g is the geometry of the receptive fields
     * @param hOffset is the horizontal shift in pixels
     * @param vOffset is the vertical shift in pixels
-    * @param mode is one of the following : RADIAL, TANGENTIAL or ELLIPTICAL
     * @param padding is the number of pad bytes of the input image (logpolar)
+    * @param cov if not null, the pixels covered by each receptive field (from the C2L table), 
+    * the table is then their transpose and the receptive fields aren't sampled again
+    * @param scratch serves the temporaries of the build
     * @return 0 when there are no errors
-    * @return 1 in case of wrong parameters
     * @return 2 in case of allocation problems
     */
-    int RCbuildL2CMap (double scaleFact, int hOffset, int vOffset, int mode, int padding);
+    int RCbuildL2CMap (const rfGeometry& g, int hOffset, int vOffset, int padding, const rfCoverage *cov, buildArena& scratch);
 
     /**
     * \brief Generates a log polar image from a cartesian one
@@ -193,21 +367,69 @@ private:
     * @param cartImg is the input Cartesian image
     * @param Table is the LUT used for the transformation
     * @param padding is the padding of the logpolar image (output)
+    * @param firstRing is the first ring of the logpolar image to generate
+    * @param lastRing is one past the last ring to generate
     is generated otherways
     */
     void RCgetLpImg (unsigned char *lpImg,
                      unsigned char *cartImg,
                      cart2LpPixel * Table, 
-                     int padding);
+                     int padding,
+                     int firstRing,
+                     int lastRing);
+
+    /**
+    * \brief Builds the rings of a lazy C2L table not built yet, a no-op otherwise. Conversions
+    * of disjoint ranges build their rings concurrently
+    * @param firstRing is the first ring to build
+    * @param lastRing is one past the last ring to build
+    * @return true iff the rings are built
+    */
+    bool RCbuildRings (int firstRing, int lastRing);
 
     /**
     * \brief Remaps a log polar image to a cartesian one
     * @param cartImg is the output Cartesian image
     * @param lpImg is the input LogPolar image
-    * @param Table is the LUT used for the transformation
-    * @param cartSize is the size of the log polar image
+    * @param padding is the padding of the cartesian image (output)
+    * @param firstRow is the first row of the cartesian image to remap
+    * @param lastRow is one past the last row to remap
+    */
+    void RCgetCartImg (unsigned char *cartImg, unsigned char *lpImg, int padding, int firstRow, int lastRow);
+
+    /**
+    * \brief Remaps a run of consecutive covered pixels of the cartesian image
+    * @param img is the output, the first pixel of the run
+    * @param lpImg is the input LogPolar image
+    * @param entry is the index of the first pixel of the run in the L2C table
+    * @param n is the number of pixels
     */
-    void RCgetCartImg (unsigned char *cartImg, unsigned char *lpImg, lp2CartPixel * Table, int cartSize);
+    void RCremapSpan (unsigned char *img, unsigned char *lpImg, int entry, int n);
+
+    /**
+    * \brief Remaps a log polar image to a rectangle of a cartesian one, only the pixels covered
+    * by the log polar image are remapped, the others are cleared
+    * @param roi is the output image, the size of the rectangle
+    * @param lpImg is the input LogPolar image
+    * @param x0 is the first column of the rectangle in the cartesian image
+    * @param y0 is the first row of the rectangle in the cartesian image
+    */
+    void RCgetCartImgRoi (yarp::sig::ImageOf<yarp::sig::PixelRgb>& roi, unsigned char *lpImg, int x0, int y0);
+
+    /**
+    * \brief Remaps a log polar image to a cartesian one blending a full resolution fovea into its centre
+    * @param cart is the output Cartesian image
+    * @param lpImg is the input LogPolar image
+    * @param fovea is the input foveal image
+    * @param mask is the blend of the fovea
+    * @param firstRow is the first row of the cartesian image to remap
+    * @param lastRow is one past the last row to remap
+    */
+    void RCgetCartImgFovea (yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart, 
+                            unsigned char *lpImg, 
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                            const foveaBlendMask& mask,
+                            int firstRow, int lastRow);
 
     /**
     * \brief Computes the logarithm index
@@ -226,9 +448,29 @@ public:
     /**
      * default constructor.
      */
-    logpolarTransform() {
+    logpolarTransform() : ringMutex_(1) {
         c2lTable = 0;
-        l2cTable = 0;
+        c2lPacked_ = false;
+        c2lReplica_ = 0;
+        nReplicas_ = 0;
+        l2cOffset = 0;
+        l2cTaps16 = 0;
+        l2cTaps32 = 0;
+        l2cSpan = 0;
+        l2cRow = 0;
+        l2cPaged_ = false;
+        clear_ = true;
+        coverage_ = SAMPLED;
+        placeholder_ = false;
+        lazy_ = false;
+        pages_ = PAGES_DEFAULT;
+        numa_ = false;
+        async_ = 0;
+        lazyGeometry_ = 0;
+        ringBuilt_ = 0;
+        ringLock_ = 0;
+        ringsLeft_ = 0;
+        allRingsBuilt_ = 0;
         necc_ = 0;
         nang_ = 0;
         width_ = 0;
@@ -247,7 +489,7 @@ public:
      * @return true iff one or both LUTs are different from zero.
      */
     virtual const bool allocated() const {
-        if (c2lTable != 0 || l2cTable != 0)
+        if (c2lTable != 0 || l2cOffset != 0)
             return true;
         else
             return false;
@@ -264,6 +506,67 @@ public:
      */
     virtual bool allocLookupTables(int mode = BOTH, int necc = 152, int nang = 252, int w = 640, int h = 480, double overlap = 1.);
 
+    /**
+     * alloc coarse lookup tables, which take a fraction of the time of the exact ones: 
+     * each receptive field samples the pixel at its center and each pixel is remapped
+     * from the closest receptive field (nearest neighbour).
+     * @param necc is the number of eccentricities of the logpolar image.
+     * @param nang is the number of angles of the logpolar image.
+     * @param w is the width of the original rectangular image.
+     * @param h is the height of the original rectangular image.
+     * @param overlap is the degree of overlap of the receptive fields (>0.).
+     * @return true iff successful.
+     */
+    virtual bool allocPlaceholderTables(int mode = BOTH, int necc = 152, int nang = 252, int w = 640, int h = 480, double overlap = 1.);
+
+    /**
+     * alloc the lookup tables without blocking: the placeholder tables are allocated
+     * straight away and the exact ones are built by a separate thread. Conversions are
+     * possible immediately; the exact tables are installed by upgradeLookupTables, 
+     * waitLookupTables or allocLookupTables.
+     * @param necc is the number of eccentricities of the logpolar image.
+     * @param nang is the number of angles of the logpolar image.
+     * @param w is the width of the original rectangular image.
+     * @param h is the height of the original rectangular image.
+     * @param overlap is the degree of overlap of the receptive fields (>0.).
+     * @return true iff the placeholder tables are allocated.
+     */
+    virtual bool allocLookupTablesAsync(int mode = BOTH, int necc = 152, int nang = 252, int w = 640, int h = 480, double overlap = 1.);
+
+    /**
+     * check whether the exact tables of an asynchronous allocation are built.
+     * @return true iff the exact tables are built (installed or not) or the build is over.
+     */
+    bool lookupTablesReady();
+
+    /**
+     * install the exact tables of an asynchronous allocation if they are built, without
+     * blocking. No conversion must be in progress, call it e.g. between two frames.
+     * @return true iff the exact tables are in use.
+     */
+    bool upgradeLookupTables();
+
+    /**
+     * wait for the exact tables of an asynchronous allocation and install them. 
+     * No conversion must be in progress.
+     * @return true iff the exact tables are in use.
+     */
+    bool waitLookupTables();
+
+    /**
+     * check whether the tables in use are the placeholder of an asynchronous allocation.
+     * @return true if the exact tables are not installed yet.
+     */
+    bool placeholder(void) const { return placeholder_; }
+
+    /**
+     * copy the lookup tables into plain arrays. Lazy rings are built first; the tables
+     * not allocated (see the mode) are left empty.
+     * @param tables receives the tables.
+     * @return true iff successful, the placeholder of an asynchronous build isn't copied.
+     */
+    bool packLookupTables(logpolarPackedTables& tables);
+
     /**
     * free the lookup tables from memory.
     * @return true iff successful.
@@ -280,6 +583,21 @@ public:
     virtual bool cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
                                 const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart);
 
+    /**
+     * converts a range of rings of an image from rectangular to logpolar, the other rings
+     * of the logpolar image are left untouched. Disjoint ranges of the same image can be 
+     * converted concurrently. With lazy rings only the rings of the range are built.
+     * @param lp is the logpolar image (destination), already of the size of the tables.
+     * @param cart is the cartesian image (source data).
+     * @param firstRing is the first ring of the logpolar image to convert.
+     * @param lastRing is one past the last ring to convert.
+     * @return true iff successful. Beware that tables must be
+     * allocated in advance.
+     */
+    virtual bool cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                                int firstRing, int lastRing);
+
     /**
      * converts an image from logpolar to cartesian (rectangular).
      * @param cart is the cartesian image (destination).
@@ -290,6 +608,146 @@ public:
     virtual bool logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
                                 const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp);
 
+    /**
+     * converts a range of rows of an image from logpolar to cartesian. Disjoint
+     * ranges of the same image can be converted concurrently.
+     * @param cart is the cartesian image (destination), already of the size of the tables.
+     * @param lp is the logpolar image (source).
+     * @param firstRow is the first row of the cartesian image to convert.
+     * @param lastRow is one past the last row to convert.
+     * @return true iff successful. Beware that tables must be
+     * allocated in advance.
+     */
+    virtual bool logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                                int firstRow, int lastRow);
+
+    /**
+     * converts a rectangle of the cartesian image from logpolar. The work is proportional 
+     * to the pixels of the rectangle covered by the logpolar image.
+     * @param roi is the cartesian image of the rectangle (destination), resized to w by h; 
+     * the pixels not covered by the logpolar image (or outside the cartesian image) are cleared.
+     * @param lp is the logpolar image (source).
+     * @param x0 is the first column of the rectangle (it might be negative).
+     * @param y0 is the first row of the rectangle (it might be negative).
+     * @param w is the width of the rectangle.
+     * @param h is the height of the rectangle.
+     * @return true iff successful. Beware that tables must be
+     * allocated in advance.
+     */
+    virtual bool logpolarToCartRoi(yarp::sig::ImageOf<yarp::sig::PixelRgb>& roi,
+                                   const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                                   int x0, int y0, int w, int h);
+
+    /**
+     * converts an image from logpolar to cartesian blending the full resolution fovea into 
+     * its centre, in a single pass.
+     * @param cart is the cartesian image (destination), already of the size of the tables.
+     * @param lp is the logpolar image (source).
+     * @param fovea is the foveal image (source), of the size the blend is computed for.
+     * @param mask is the blend of the fovea, computed for the size of the tables.
+     * @return true iff successful, false without a message if the fovea doesn't match 
+     * the blend. Beware that tables must be allocated in advance.
+     */
+    virtual bool logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                                const foveaBlendMask& mask);
+
+    /**
+     * converts a range of rows of an image from logpolar to cartesian blending the full 
+     * resolution fovea into its centre. Disjoint ranges can be converted concurrently.
+     * @param cart is the cartesian image (destination), already of the size of the tables.
+     * @param lp is the logpolar image (source).
+     * @param fovea is the foveal image (source), of the size the blend is computed for.
+     * @param mask is the blend of the fovea, computed for the size of the tables.
+     * @param firstRow is the first row of the cartesian image to convert.
+     * @param lastRow is one past the last row to convert.
+     * @return true iff successful, false without a message if the fovea doesn't match 
+     * the blend. Beware that tables must be allocated in advance.
+     */
+    virtual bool logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                                const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                                const foveaBlendMask& mask,
+                                int firstRow, int lastRow);
+
+    /**
+     * choose whether the conversion to cartesian clears the pixels not covered by the 
+     * logpolar image (the default) or leaves them untouched, e.g. when drawing over 
+     * an image that is already cleared or when only the covered pixels are of interest.
+     * The region of interest conversion always clears them.
+     * @param clear is true to clear the uncovered pixels.
+     */
+    void setClearUncovered(bool clear) { clear_ = clear; }
+
+    /**
+     * check whether the conversion to cartesian clears the uncovered pixels.
+     * @return true if the uncovered pixels are cleared (default = true).
+     */
+    bool clearUncovered(void) const { return clear_; }
+
+    /**
+     * choose how the coverage of the receptive fields is computed when building the tables.
+     * SAMPLED (the default) tests a grid of points within each receptive field, ANALYTIC 
+     * computes the exact area of each pixel covered by each receptive field, which is faster
+     * and weighs the pixels by their area. Call it before allocLookupTables; the 
+     * two methods build slightly different tables, which is useful for validation.
+     * @param method is one of SAMPLED or ANALYTIC.
+     */
+    void setCoverageMethod(int method) { coverage_ = (method == ANALYTIC) ? ANALYTIC : SAMPLED; }
+
+    /**
+     * check how the coverage of the receptive fields is computed.
+     * @return one of SAMPLED or ANALYTIC (default = SAMPLED).
+     */
+    int coverageMethod(void) const { return coverage_; }
+
+    /**
+     * choose whether the rings of the C2L table are built on first access instead of by
+     * allocLookupTables. Startup time and memory then grow with the rings actually converted,
+     * which pays off when only the inner rings are read (the outer rings are the largest).
+     * The L2C table, if any, is built at once. Call it before allocLookupTables.
+     * @param lazy is true to build the rings on first access.
+     */
+    void setLazyRings(bool lazy) { lazy_ = lazy; }
+
+    /**
+     * check whether the rings of the C2L table are built on first access.
+     * @return true if the rings are built lazily (default = false).
+     */
+    bool lazyRings(void) const { return lazy_; }
+
+    /**
+     * choose where the lookup tables are allocated. The tables of large geometries take
+     * tens of MB and are read at random, on huge pages they take a handful of TLB entries.
+     * The C2L table is then packed in a single block. Call it before allocLookupTables;
+     * it has no effect on lazy rings nor outside of Linux.
+     * @param pages is one of PAGES_DEFAULT, PAGES_TRANSPARENT or PAGES_HUGE.
+     */
+    void setTablePages(int pages) { pages_ = (pages == PAGES_TRANSPARENT || pages == PAGES_HUGE) ? pages : PAGES_DEFAULT; }
+
+    /**
+     * check where the lookup tables are allocated.
+     * @return one of PAGES_DEFAULT, PAGES_TRANSPARENT or PAGES_HUGE (default = PAGES_DEFAULT).
+     */
+    int tablePages(void) const { return pages_; }
+
+    /**
+     * choose whether the C2L table is replicated on each NUMA node of the host, so that
+     * each conversion reads the copy local to the node it is running on. It pays off on
+     * multi-socket hosts converting on several threads. Call it before allocLookupTables;
+     * it has no effect on lazy rings nor on single node hosts.
+     * @param numa is true to replicate the table.
+     */
+    void setNumaReplicas(bool numa) { numa_ = numa; }
+
+    /**
+     * check whether the C2L table is replicated on each NUMA node.
+     * @return true if the table is replicated (default = false).
+     */
+    bool numaReplicas(void) const { return numa_; }
+
     /**
      * check the number of eccentricities (rings).
      * @return the number of rings in the logpolar mapping (default 152).
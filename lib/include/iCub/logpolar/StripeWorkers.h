@@ -0,0 +1,113 @@
+/*
+ *  logpolar mapper library. a small pool of threads processing images by stripes.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program 
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be 
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A 
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file StripeWorkers.h \brief A pool of threads splitting the processing of an image in 
+ * horizontal stripes.
+ */
+
+#ifndef __ICUB_LOGPOLAR_STRIPEWORKERS_H__
+#define __ICUB_LOGPOLAR_STRIPEWORKERS_H__
+
+#include <yarp/os/Thread.h>
+#include <yarp/os/Semaphore.h>
+
+namespace iCub {
+    namespace logpolar {
+        class StripeJob;
+        class StripeWorkers;
+    }
+}
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * A job that can be split in stripes, e.g. the rows of an image. Stripes are independent 
+ * and can be processed concurrently.
+ */
+class iCub::logpolar::StripeJob {
+public:
+    virtual ~StripeJob() {}
+
+    /**
+     * process a stripe of the job.
+     * @param stripe is the index of the stripe (0 to stripes-1).
+     * @param stripes is the total number of stripes.
+     */
+    virtual void processStripe(int stripe, int stripes) = 0;
+
+    /**
+     * utility to split a range in stripes of similar size.
+     * @param n is the size of the range (e.g. the number of rows).
+     * @param stripe is the index of the stripe.
+     * @param stripes is the total number of stripes.
+     * @param first is the first element of the stripe.
+     * @param last is one past the last element of the stripe.
+     */
+    static void getStripe(int n, int stripe, int stripes, int& first, int& last) {
+        first = (n * stripe) / stripes;
+        last = (n * (stripe+1)) / stripes;
+    }
+};
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * A pool of threads running the stripes of a StripeJob. The calling thread processes 
+ * one of the stripes as well, thus a pool of size 1 has no extra threads and simply 
+ * runs the job sequentially.
+ */
+class iCub::logpolar::StripeWorkers {
+private:
+    class Worker;
+    friend class Worker;
+
+    Worker **workers;
+    int nWorkers;
+    StripeJob *job;
+    int stripes;
+    yarp::os::Semaphore done;
+    yarp::os::Semaphore mutex;
+
+    StripeWorkers(const StripeWorkers&);
+    void operator=(const StripeWorkers&);
+
+public:
+    /**
+     * constructor.
+     * @param n is the number of stripes processed concurrently, including the calling thread.
+     */
+    StripeWorkers(int n = 1);
+
+    /** destructor, stops the threads. */
+    ~StripeWorkers();
+
+    /**
+     * the number of stripes processed concurrently.
+     * @return the number of threads including the calling one.
+     */
+    int size() const { return nWorkers + 1; }
+
+    /**
+     * run a job, one stripe per thread, and wait for its completion. Calls from
+     * different threads are serialized.
+     * @param j is the job.
+     */
+    void run(StripeJob& j);
+};
+
+#endif
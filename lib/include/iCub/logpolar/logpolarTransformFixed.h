@@ -0,0 +1,288 @@
+/*
+ *  logpolar mapper library. the lookup tables of a fixed geometry and the conversions on them.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarTransformFixed.h \brief A loader of the lookup tables of a geometry known at
+ * compile time, compiled into the library or built at run time, with the conversions on them.
+ */
+
+#ifndef __ICUB_LOGPOLAR_LOGPOLARTRANSFORMFIXED_H__
+#define __ICUB_LOGPOLAR_LOGPOLARTRANSFORMFIXED_H__
+
+#include <cstring>
+#include <iostream>
+
+#include <yarp/sig/Image.h>
+#include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+
+namespace iCub {
+    namespace logpolar {
+        template <int NECC, int NANG, int W, int H> class logpolarTransformFixed;
+
+        /**
+         * \struct logpolarFixedTables
+         * \brief The read-only look-up tables of a geometry, see logpolarPackedTables for the
+         * content of the arrays.
+         *
+         */
+        struct logpolarFixedTables
+        {
+            int necc;                           /**< Number of rings. */
+            int nang;                           /**< Number of angles. */
+            int width;                          /**< Width of the cartesian image. */
+            int height;                         /**< Height of the cartesian image. */
+            double overlap;                     /**< Overlap of the receptive fields. */
+            const unsigned int *c2lOffset;
+            const int *c2lPosition;
+            const int *c2lWeight;
+            const int *l2cSpan;
+            const int *l2cRow;
+            const unsigned int *l2cOffset;
+            const unsigned int *l2cTaps;
+        };
+
+        /**
+         * look for the tables of a geometry among the ones compiled into the library
+         * (see the LOGPOLAR_FIXED_TABLES option of the build).
+         * @param necc is the number of rings.
+         * @param nang is the number of angles.
+         * @param w is the width of the cartesian image.
+         * @param h is the height of the cartesian image.
+         * @param overlap is the overlap of the receptive fields.
+         * @return the tables, 0 if they aren't compiled in.
+         */
+        const logpolarFixedTables *findFixedTables(int necc, int nang, int w, int h, double overlap);
+    }
+}
+
+/**
+ * \ingroup logpolarLibrary
+ *
+ * The lookup tables of a geometry fixed at compile time, e.g.
+ * logpolarTransformFixed<152, 252, 640, 480>, and the conversions that read them. This is
+ * a table loader: the tables are taken from the library when compiled in, thus at no startup
+ * cost, and built as by logpolarTransform otherwise. The geometry only sets the image sizes
+ * checked, the ring/angle loop bounds and the row strides; the work per pixel depends on the
+ * tables and is not unrolled or vectorized by the compiler. What the conversions gain over
+ * logpolarTransform comes from the tables being contiguous, not from the constants. Images
+ * must be of the exact size of the geometry.
+ */
+template <int NECC, int NANG, int W, int H>
+class iCub::logpolar::logpolarTransformFixed {
+public:
+    enum {
+        CART_PADDING = (W * 3 % YARP_IMAGE_ALIGN) ? YARP_IMAGE_ALIGN - W * 3 % YARP_IMAGE_ALIGN : 0,
+        LP_PADDING = (NANG * 3 % YARP_IMAGE_ALIGN) ? YARP_IMAGE_ALIGN - NANG * 3 % YARP_IMAGE_ALIGN : 0,
+        CART_STRIDE = W * 3 + CART_PADDING,
+        LP_STRIDE = NANG * 3 + LP_PADDING
+    };
+
+private:
+    logpolarFixedTables tables_;    // the tables in use, compiled in or pointing into packed_.
+    logpolarPackedTables *packed_;  // the tables built at run time, 0 if compiled in.
+    bool allocated_;
+
+    // forbid copies.
+    logpolarTransformFixed(const logpolarTransformFixed& x);
+    void operator=(const logpolarTransformFixed& x);
+
+public:
+    /**
+     * default constructor.
+     */
+    logpolarTransformFixed() {
+        memset(&tables_, 0, sizeof(tables_));
+        packed_ = 0;
+        allocated_ = false;
+    }
+
+    /** destructor */
+    ~logpolarTransformFixed() {
+        freeLookupTables();
+    }
+
+    /**
+     * check whether the tables have been allocated.
+     * @return true iff the tables are available.
+     */
+    bool allocated() const { return allocated_; }
+
+    /**
+     * check whether the tables in use are compiled into the library.
+     * @return true if the tables cost nothing at startup.
+     */
+    bool compiledIn() const { return allocated_ && packed_ == 0; }
+
+    /**
+     * alloc the lookup tables, taken from the library if compiled in and built otherwise.
+     * @param overlap is the degree of overlap of the receptive fields (>0.).
+     * @return true iff successful.
+     */
+    bool allocLookupTables(double overlap = 1.) {
+        if (allocated_) {
+            if (overlap != tables_.overlap) {
+                std::cerr << "logpolarTransformFixed: new overlap differs from the allocated maps" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        const logpolarFixedTables *t = findFixedTables(NECC, NANG, W, H, overlap);
+        if (t != 0) {
+            tables_ = *t;
+            allocated_ = true;
+            return true;
+        }
+
+        logpolarTransform trsf;
+        packed_ = new logpolarPackedTables;
+        if (!trsf.allocLookupTables(BOTH, NECC, NANG, W, H, overlap) || !trsf.packLookupTables(*packed_)) {
+            delete packed_;
+            packed_ = 0;
+            return false;
+        }
+
+        tables_.necc = NECC;
+        tables_.nang = NANG;
+        tables_.width = W;
+        tables_.height = H;
+        tables_.overlap = overlap;
+        tables_.c2lOffset = &packed_->c2lOffset[0];
+        tables_.c2lPosition = &packed_->c2lPosition[0];
+        tables_.c2lWeight = &packed_->c2lWeight[0];
+        tables_.l2cSpan = &packed_->l2cSpan[0];
+        tables_.l2cRow = &packed_->l2cRow[0];
+        tables_.l2cOffset = &packed_->l2cOffset[0];
+        tables_.l2cTaps = (packed_->l2cTaps.size() > 0) ? &packed_->l2cTaps[0] : 0;
+        allocated_ = true;
+        return true;
+    }
+
+    /**
+     * free the lookup tables from memory.
+     * @return true iff successful.
+     */
+    bool freeLookupTables() {
+        if (packed_) delete packed_;
+        packed_ = 0;
+        memset(&tables_, 0, sizeof(tables_));
+        allocated_ = false;
+        return true;
+    }
+
+    /**
+     * converts an image from rectangular to logpolar.
+     * @param lp is the logpolar image (destination), resized to NANG by NECC.
+     * @param cart is the cartesian image (source data), W by H.
+     * @return true iff successful.
+     */
+    bool cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                        const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart) {
+        lp.resize(NANG, NECC);
+        if (!allocated_ || cart.width() != W || cart.height() != H ||
+            cart.getRowSize() != CART_STRIDE || lp.getRowSize() != LP_STRIDE) {
+            std::cerr << "logpolarTransformFixed: tables or image sizes don't match the geometry" << std::endl;
+            return false;
+        }
+
+        const unsigned char *cartImg = cart.getRawImage();
+        const unsigned int *offset = tables_.c2lOffset;
+        const int *position = tables_.c2lPosition;
+        const int *weight = tables_.c2lWeight;
+
+        for (int i = 0; i < NECC; i++) {
+            unsigned char *img = lp.getRawImage() + i * LP_STRIDE;
+            for (int j = 0; j < NANG; j++, offset++) {
+                int r = 0, g = 0, b = 0, t = 0;
+                const unsigned int last = offset[1];
+                for (unsigned int k = offset[0]; k < last; k++) {
+                    const unsigned char *in = cartImg + position[k];
+                    const int w = weight[k];
+                    r += in[0] * w;
+                    g += in[1] * w;
+                    b += in[2] * w;
+                    t += w;
+                }
+
+                *img++ = (unsigned char)(r / t);
+                *img++ = (unsigned char)(g / t);
+                *img++ = (unsigned char)(b / t);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * converts an image from logpolar to cartesian (rectangular), the pixels not covered
+     * by the logpolar image are cleared.
+     * @param cart is the cartesian image (destination), resized to W by H.
+     * @param lp is the logpolar image (source), NANG by NECC.
+     * @return true iff successful.
+     */
+    bool logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                        const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp) {
+        cart.resize(W, H);
+        if (!allocated_ || lp.width() != NANG || lp.height() != NECC ||
+            lp.getRowSize() != LP_STRIDE || cart.getRowSize() != CART_STRIDE) {
+            std::cerr << "logpolarTransformFixed: tables or image sizes don't match the geometry" << std::endl;
+            return false;
+        }
+
+        const unsigned char *lpImg = lp.getRawImage();
+        const unsigned int *taps = tables_.l2cTaps;
+
+        for (int k = 0; k < H; k++) {
+            // only the span of covered pixels has entries in the table.
+            const int first = tables_.l2cSpan[2*k];
+            const int last = tables_.l2cSpan[2*k+1];
+            const unsigned int *offset = tables_.l2cOffset + tables_.l2cRow[k];
+            unsigned char *img = cart.getRawImage() + k * CART_STRIDE;
+
+            memset(img, 0, first * 3);
+            img += first * 3;
+
+            for (int j = first; j < last; j++, offset++) {
+                const unsigned int f = offset[0];
+                const unsigned int l = offset[1];
+                if (f == l) {
+                    *img++ = 0;
+                    *img++ = 0;
+                    *img++ = 0;
+                    continue;
+                }
+
+                int r = 0, g = 0, b = 0;
+                for (unsigned int i = f; i < l; i++) {
+                    const unsigned char *in = lpImg + taps[i];
+                    r += in[0];
+                    g += in[1];
+                    b += in[2];
+                }
+
+                const int w = (int)(l - f);
+                *img++ = r / w;
+                *img++ = g / w;
+                *img++ = b / w;
+            }
+
+            memset(img, 0, (W - last) * 3);
+        }
+        return true;
+    }
+};
+
+#endif
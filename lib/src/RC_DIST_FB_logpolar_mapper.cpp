@@ -24,12 +24,24 @@
  */
 
 #include <yarp/sig/IplImage.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Semaphore.h>
 #include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
 
+#include "logpolarKernels.h"
+
 #include <cstring>
+#include <cstdio>
+#include <vector>
 #include <cmath>
 #include <iostream>
 
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 using namespace std;
 using namespace yarp::os;
 using namespace yarp::sig;
@@ -49,14 +61,16 @@ bool iCub::logpolar::subsampleFovea(yarp::sig::ImageOf<yarp::sig::PixelRgb>& dst
     const int col = src.width()/2-fov/2;
     const int bytes = fov*sizeof(PixelRgb);
 
-    for (int i = 0; i < fov; i++) {
-        unsigned char *s = (unsigned char *)src.getRow(i+offset)+col*sizeof(PixelRgb);
-        unsigned char *d = dst.getRow(i);
-        memcpy(d, s, bytes);
-    }
+    const unsigned char *s = (unsigned char *)src.getRow(offset)+col*sizeof(PixelRgb);
+    kernels().copyRows(dst.getRawImage(), dst.getRowSize(), s, src.getRowSize(), bytes, fov);
     return true;
 }
 
+//
+const char *iCub::logpolar::kernelInstructionSet() {
+    return kernels().name;
+}
+
 //
 bool iCub::logpolar::replicateBorderLogpolar(yarp::sig::Image& dest, const yarp::sig::Image& src, int maxkernelsize) {
     //
@@ -76,11 +90,7 @@ bool iCub::logpolar::replicateBorderLogpolar(yarp::sig::Image& dest, const yarp:
     unsigned char *s = src.getRawImage();
     const int bytes = src.width() * pxsize;
 
-    for (int i = 0; i < src.height(); i++) {
-        memcpy(d, s, bytes);
-        d += dest.getRowSize();
-        s += src.getRowSize();
-    }
+    kernels().copyRows(d, dest.getRowSize(), s, src.getRowSize(), bytes, src.height());
 
     // memcpy of the horizontal fovea lines (rows) 
     const int sizeBlock = src.width() / 2;
@@ -109,6 +119,372 @@ bool iCub::logpolar::replicateBorderLogpolar(yarp::sig::Image& dest, const yarp:
     return true;
 }
 
+//
+bool iCub::logpolar::allocFoveaBlendMask(foveaBlendMask& mask, int w, int h, int fovea, double scale, int border) {
+    //
+    freeFoveaBlendMask(mask);
+    if (w <= 0 || h <= 0 || fovea <= 0 || scale <= 0.) {
+        cerr << "allocFoveaBlendMask: can't compute the blend for the requested sizes" << endl;
+        return false;
+    }
+
+    // the fovea is cut from the centre of the image the logpolar image is sampled from, it 
+    // goes in the centre of the reconstruction.
+    const int size = (int)(fovea * scale + .5);
+    if (size <= 0)
+        return false;
+
+    mask.size = size;
+    mask.fovea = fovea;
+    mask.x0 = w/2 - size/2;
+    mask.y0 = h/2 - size/2;
+    mask.xs = new int[size];
+    mask.ys = new int[size];
+    mask.alpha = new int[size * size];
+
+    for (int i = 0; i < size; i++) {
+        int k = (int)((i + .5) / scale);
+        if (k >= fovea) k = fovea - 1;
+        mask.xs[i] = k * 3;
+        mask.ys[i] = k;
+    }
+
+    if (border < 0) border = 0;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            int d = i;
+            if (j < d) d = j;
+            if (size-1-i < d) d = size-1-i;
+            if (size-1-j < d) d = size-1-j;
+            mask.alpha[i * size + j] = (d >= border) ? 256 : (256 * (d + 1)) / (border + 1);
+        }
+    }
+    return true;
+}
+
+//
+void iCub::logpolar::freeFoveaBlendMask(foveaBlendMask& mask) {
+    //
+    if (mask.xs) delete[] mask.xs;
+    if (mask.ys) delete[] mask.ys;
+    if (mask.alpha) delete[] mask.alpha;
+    mask = foveaBlendMask();
+}
+
+// the memory of the placed tables (huge pages, NUMA node): a header in front of the data 
+// records the mapping. Elsewhere than on Linux it is plain memory.
+struct pagesHeader {
+    void *base;
+    size_t length;
+    bool mapped;
+};
+
+static const size_t TABLE_PAGES_HEADER = 64;
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static void bindToNode (void *addr, size_t length, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    // MPOL_BIND, without depending on libnuma.
+    const int bits = 8 * sizeof(unsigned long);
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+    if (node < 0 || node >= 1024)
+        return;
+    memset (mask, 0, sizeof(mask));
+    mask[node / bits] |= 1UL << (node % bits);
+    syscall (SYS_mbind, addr, length, 2, mask, (unsigned long)(sizeof(mask) * 8), 0);
+#endif
+}
+
+static void *allocTablePages (size_t bytes, int pages, int node)
+{
+    const size_t total = bytes + TABLE_PAGES_HEADER;
+#if defined(__linux__)
+    if (pages != PAGES_DEFAULT || node >= 0) {
+        const size_t length = (total + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        char *base = (char *)MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (pages == PAGES_HUGE)
+            base = (char *)mmap (0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if (base == (char *)MAP_FAILED) {
+            // transparent huge pages (or no explicit ones reserved): the mapping is aligned
+            // to the huge page size so that the kernel can back it with huge pages.
+            char *raw = (char *)mmap (0, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw != (char *)MAP_FAILED) {
+                base = (char *)(((size_t)raw + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+                if (base > raw) munmap (raw, base - raw);
+                if (raw + HUGE_PAGE_SIZE > base) munmap (base + length, raw + HUGE_PAGE_SIZE - base);
+#ifdef MADV_HUGEPAGE
+                if (pages != PAGES_DEFAULT)
+                    madvise (base, length, MADV_HUGEPAGE);
+#endif
+            }
+        }
+
+        if (base != (char *)MAP_FAILED) {
+            // the policy applies to the pages not touched yet, i.e. all of them.
+            if (node >= 0)
+                bindToNode (base, length, node);
+            pagesHeader *h = (pagesHeader *)base;
+            h->base = base;
+            h->length = length;
+            h->mapped = true;
+            return base + TABLE_PAGES_HEADER;
+        }
+    }
+#endif
+    char *base = new char[total];
+    if (base == 0)
+        return 0;
+    pagesHeader *h = (pagesHeader *)base;
+    h->base = base;
+    h->length = total;
+    h->mapped = false;
+    return base + TABLE_PAGES_HEADER;
+}
+
+static void freeTablePages (void *data)
+{
+    if (data == 0)
+        return;
+    pagesHeader *h = (pagesHeader *)((char *)data - TABLE_PAGES_HEADER);
+#if defined(__linux__)
+    if (h->mapped) {
+        munmap (h->base, h->length);
+        return;
+    }
+#endif
+    delete[] (char *)h->base;
+}
+
+// the NUMA nodes of the host (one past the highest), 1 without NUMA.
+static int countNumaNodes ()
+{
+    int n = 1;
+#if defined(__linux__)
+    char path[64];
+    for (int i = 1; i < 64; i++) {
+        sprintf (path, "/sys/devices/system/node/node%d", i);
+        if (access (path, F_OK) == 0)
+            n = i + 1;
+    }
+#endif
+    return n;
+}
+
+// the NUMA node of the calling thread, -1 if unknown.
+static int currentNumaNode ()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu = 0, node = 0;
+    if (syscall (SYS_getcpu, &cpu, &node, (void *)0) == 0)
+        return (int)node;
+#endif
+    return -1;
+}
+
+// a flag set by one thread and read by others without a lock (see RCbuildRings).
+static inline bool loadAcquire (const int *flag)
+{
+#if defined(__GNUC__)
+    return __atomic_load_n (flag, __ATOMIC_ACQUIRE) != 0;
+#else
+    // MSVC gives volatile accesses acquire/release semantics.
+    return *(volatile const int *)flag != 0;
+#endif
+}
+
+static inline void storeRelease (int *flag, int value)
+{
+#if defined(__GNUC__)
+    __atomic_store_n (flag, value, __ATOMIC_RELEASE);
+#else
+    *(volatile int *)flag = value;
+#endif
+}
+
+// the scratch memory of the table builds: served in order from a chain of blocks (usually
+// one), reused by rewinding to a mark and released in one shot by the destructor.
+struct logpolarTransform::buildArena
+{
+    struct block {
+        block *prev;
+        size_t size;
+        size_t used;
+    };
+    struct marker {
+        block *top;
+        size_t used;
+    };
+
+    block *top;
+
+    buildArena() : top(0) {}
+
+    ~buildArena() {
+        while (top) {
+            block *b = top;
+            top = top->prev;
+            delete[] (char *)b;
+        }
+    }
+
+    static size_t header() { return (sizeof(block) + 15) & ~(size_t)15; }
+
+    // makes room for bytes more without a further block, an empty arena swaps its block.
+    bool reserve(size_t bytes) {
+        bytes = (bytes + 15) & ~(size_t)15;
+        if (top != 0 && top->size - top->used >= bytes)
+            return true;
+
+        block *b = (block *) new char[header() + bytes];
+        if (b == 0)
+            return false;
+        b->size = bytes;
+        b->used = 0;
+        b->prev = top;
+        if (top != 0 && top->used == 0 && top->prev == 0) {
+            delete[] (char *)top;
+            b->prev = 0;
+        }
+        top = b;
+        return true;
+    }
+
+    void *allocBytes(size_t bytes) {
+        bytes = (bytes + 15) & ~(size_t)15;
+        if (top == 0 || top->size - top->used < bytes) {
+            const size_t size = (top != 0 && top->size > bytes) ? top->size : bytes;
+            block *b = (block *) new char[header() + size];
+            if (b == 0)
+                return 0;
+            b->size = size;
+            b->used = 0;
+            b->prev = top;
+            top = b;
+        }
+        void *x = (char *)top + header() + top->used;
+        top->used += bytes;
+        return x;
+    }
+
+    template <class T> T *alloc(size_t n) { return (T *) allocBytes(n * sizeof(T)); }
+
+    marker mark() const {
+        marker m;
+        m.top = top;
+        m.used = (top != 0) ? top->used : 0;
+        return m;
+    }
+
+    // frees the blocks added after the mark, the first block is kept for reuse.
+    void rewind(const marker& m) {
+        while (top != 0 && top != m.top && top->prev != 0) {
+            block *b = top;
+            top = top->prev;
+            delete[] (char *)b;
+        }
+        if (top != 0)
+            top->used = (top == m.top) ? m.used : 0;
+    }
+};
+
+// the geometry of the receptive fields, computed once for all the tables.
+struct logpolarTransform::rfGeometry
+{
+    int mode;                   // RADIAL, TANGENTIAL or ELLIPTICAL
+    int necc;
+    int nang;
+    double scaleFact;
+    double *currRad;            // distance of the center of the RF's of each ring from the center of the mapping
+    double *tangaxis;
+    double *radialaxis;
+    double *focus;
+    double *radii;              // the axis of RADIAL and TANGENTIAL mode (one of the two above)
+    double *sintable;           // angular positions of the centers of the RF's
+    double *costable;
+    int *lim;                   // half side of the bounding box of the RF's of each ring
+    buildArena arena;           // the arrays above, in one block
+
+    rfGeometry() : mode(ELLIPTICAL), necc(0), nang(0), scaleFact(0), currRad(0), tangaxis(0), radialaxis(0), 
+        focus(0), radii(0), sintable(0), costable(0), lim(0) {}
+
+    // the center, the foci and the major semi-axis of the RF (rho, theta).
+    void shape (int rho, int theta, double& x0, double& y0, 
+                double& F0x, double& F0y, double& F1x, double& F1y, double& maxaxis) const {
+        x0 = scaleFact * currRad[rho] * costable[theta];
+        y0 = scaleFact * currRad[rho] * sintable[theta];
+
+        if (focus[rho] >= 0) {
+            F0x = x0 - focus[rho] * sintable[theta];
+            F0y = y0 + focus[rho] * costable[theta];
+            F1x = x0 + focus[rho] * sintable[theta];
+            F1y = y0 - focus[rho] * costable[theta];
+            maxaxis = tangaxis[rho];
+        }
+        else {
+            F0x = x0 - focus[rho] * costable[theta];
+            F0y = y0 - focus[rho] * sintable[theta];
+            F1x = x0 + focus[rho] * costable[theta];
+            F1y = y0 + focus[rho] * sintable[theta];
+            maxaxis = radialaxis[rho];
+        }
+
+        if ((mode == RADIAL) || (mode == TANGENTIAL))
+            maxaxis = radii[rho];
+    }
+};
+
+// the pixels (y*width+x) covered by each RF, the RF's in the order of the logpolar image.
+struct logpolarTransform::rfCoverage
+{
+    std::vector<int> offset;    // the first pixel of each RF, plus the total
+    std::vector<int> pixels;
+};
+
+// builds the exact tables of a transform in background (see allocLookupTablesAsync).
+class logpolarTransform::AsyncBuilder : public yarp::os::Thread
+{
+public:
+    logpolarTransform *staging; // the tables being built, installed by upgradeLookupTables
+    int mode, necc, nang, w, h;
+    double overlap;
+    bool ok;
+    bool done;
+    yarp::os::Semaphore mutex;
+
+    AsyncBuilder(logpolarTransform *t, int m, int ne, int na, int width, int height, double ovl) : mutex(1) {
+        staging = t;
+        mode = m;
+        necc = ne;
+        nang = na;
+        w = width;
+        h = height;
+        overlap = ovl;
+        ok = false;
+        done = false;
+    }
+
+    ~AsyncBuilder() {
+        if (staging) delete staging;
+    }
+
+    virtual void run() {
+        const bool r = staging->allocLookupTables(mode, necc, nang, w, h, overlap);
+        mutex.wait();
+        ok = r;
+        done = true;
+        mutex.post();
+    }
+
+    bool finished() {
+        mutex.wait();
+        const bool d = done;
+        mutex.post();
+        return d;
+    }
+};
 
 // implementation of the ILogpolarAPI interface.
 bool logpolarTransform::allocLookupTables(int mode, int necc, int nang, int w, int h, double overlap) {
@@ -120,6 +496,10 @@ bool logpolarTransform::allocLookupTables(int mode, int necc, int nang, int w, i
             return false;
         }
 
+        // the placeholder of an asynchronous build is replaced by the exact tables.
+        if (placeholder_)
+            return waitLookupTables();
+
         cerr << "logpolarTransform: tried a reallocation of already configured maps, no action taken" << endl;
         return true;
     }
@@ -131,6 +511,14 @@ bool logpolarTransform::allocLookupTables(int mode, int necc, int nang, int w, i
     overlap_ = overlap;
     mode_ = mode;
     const double scaleFact = RCcomputeScaleFactor ();    
+
+    // the geometry is computed once, with both tables the coverage computed for the C2L
+    // table is transposed into the L2C one.
+    rfGeometry geometry;
+    rfCoverage coverage;
+    buildArena scratch;         // the temporaries of both builds, released at once
+    if (RCcomputeRFGeometry (geometry, scaleFact, ELLIPTICAL) != 0)
+        return false;
     
     if (c2lTable == 0 && (mode & C2L)) {
         c2lTable = new cart2LpPixel[necc*nang];
@@ -139,182 +527,782 @@ bool logpolarTransform::allocLookupTables(int mode, int necc, int nang, int w, i
             return false;
         }
 
-        RCbuildC2LMap (scaleFact, ELLIPTICAL, PAD_BYTES(w*3, YARP_IMAGE_ALIGN));
+        // the rings not built (yet) have no entries to free.
+        memset (c2lTable, 0, necc * nang * sizeof(cart2LpPixel));
+
+        if (lazy_) {
+            // the rings are built on first access, the geometry is kept until then.
+            lazyGeometry_ = new rfGeometry;
+            ringBuilt_ = new bool[necc];
+            ringLock_ = new yarp::os::Semaphore[necc];
+            for (int i = 0; i < necc; i++)
+                ringBuilt_[i] = false;
+            ringsLeft_ = necc;
+            allRingsBuilt_ = 0;
+            if (RCcomputeRFGeometry (*lazyGeometry_, scaleFact, ELLIPTICAL) != 0) {
+                RCdeAllocateC2LTable ();
+                return false;
+            }
+        }
+        else
+        if (RCbuildC2LMap (geometry, PAD_BYTES(w*3, YARP_IMAGE_ALIGN), (mode & L2C) ? &coverage : 0, scratch) != 0) {
+            RCdeAllocateC2LTable ();
+            return false;
+        }
     }
 
-    if (l2cTable == 0 && (mode & L2C)) {
-        l2cTable = new lp2CartPixel[w*h];
-        if (l2cTable == 0) {
+    if (l2cOffset == 0 && (mode & L2C)) {
+        // the table is allocated by the build, for the covered pixels only.
+        const rfCoverage *cov = (c2lTable != 0 && coverage.offset.size() > 0) ? &coverage : 0;
+        if (RCbuildL2CMap (geometry, 0, 0, PAD_BYTES(nang*3, YARP_IMAGE_ALIGN), cov, scratch) != 0) {
             cerr << "logPolarLibrary: can't allocate l2c lookup tables, wrong size?" << endl;
             return false;
         }
+    }
 
-        RCbuildL2CMap (scaleFact, 0, 0, ELLIPTICAL, PAD_BYTES(nang*3, YARP_IMAGE_ALIGN));
+    if (!RCplaceTables ()) {
+        // the tables are still usable from where they were built.
+        cerr << "logPolarLibrary: can't place the lookup tables on huge pages, using them where they are" << endl;
     }
     return true;
 }
 
 bool logpolarTransform::freeLookupTables() {
+    if (async_) {
+        // waits for the build in progress.
+        async_->stop();
+        delete async_;
+        async_ = 0;
+    }
+    placeholder_ = false;
     if (c2lTable)
         RCdeAllocateC2LTable ();
-    if (l2cTable)
+    if (l2cOffset)
         RCdeAllocateL2CTable ();
     return true;
 }
 
-bool logpolarTransform::cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
-                                       const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart) {
-    if (!(mode_ & C2L)) {
-        cerr << "logPolarLibrary: conversion to logpolar called with wrong mode set" << endl;
+bool logpolarTransform::allocPlaceholderTables(int mode, int necc, int nang, int w, int h, double overlap) {
+    //
+    if (allocated()) {
+        cerr << "logpolarTransform: tried a reallocation of already configured maps, no action taken" << endl;
+        return (mode == mode_ && necc == necc_ && nang == nang_ && w == width_ && h == height_ && overlap == overlap_);
+    }
+
+    necc_ = necc;
+    nang_ = nang;
+    width_ = w;
+    height_ = h;
+    overlap_ = overlap;
+    mode_ = mode;
+
+    rfGeometry geometry;
+    if (RCcomputeRFGeometry (geometry, RCcomputeScaleFactor (), ELLIPTICAL) != 0)
+        return false;
+
+    if (RCbuildPlaceholderMaps (geometry, mode, PAD_BYTES(w*3, YARP_IMAGE_ALIGN), PAD_BYTES(nang*3, YARP_IMAGE_ALIGN)) != 0) {
+        cerr << "logPolarLibrary: can't allocate the placeholder lookup tables, wrong size?" << endl;
         return false;
     }
 
-    // LATER: assert whether lp & cart are effectively nang * necc as the c2lTable requires.
-    RCgetLpImg (lp.getRawImage(), (unsigned char *)cart.getRawImage(), c2lTable, lp.getPadding());
+    placeholder_ = true;
     return true;
 }
 
-bool logpolarTransform::logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
-                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp) {
-    if (!(mode_ & L2C)) {
-        cerr << "logPolarLibrary: conversion to cartesian called with wrong mode set" << endl;
-        return false;
+bool logpolarTransform::allocLookupTablesAsync(int mode, int necc, int nang, int w, int h, double overlap) {
+    //
+    if (allocated()) {
+        if (mode != mode_ || necc != necc_ || nang != nang_ || w != width_ || h != height_ || overlap != overlap_) {
+            cerr << "logpolarTransform: new size differ from previously allocated maps" << endl;
+            return false;
+        }
+        return true;
     }
 
-    // LATER: assert whether lp & cart are effectively of the correct size.
-    RCgetCartImg (cart.getRawImage(), lp.getRawImage(), l2cTable, cart.getPadding());
+    if (!allocPlaceholderTables(mode, necc, nang, w, h, overlap))
+        return false;
 
+    // the exact tables are built by a separate transform and then moved here.
+    logpolarTransform *staging = new logpolarTransform;
+    staging->setCoverageMethod(coverage_);
+    staging->setTablePages(pages_);
+    staging->setNumaReplicas(numa_);
+    async_ = new AsyncBuilder(staging, mode, necc, nang, w, h, overlap);
+    if (!async_->start()) {
+        cerr << "logPolarLibrary: can't start building the lookup tables, the placeholder is kept" << endl;
+        delete async_;
+        async_ = 0;
+    }
     return true;
 }
 
-// internal implementation of the logpolarTransform class.
-
-inline double __max64f (double x, double y) {
-    return (x > y) ? x : y;
+bool logpolarTransform::lookupTablesReady() {
+    //
+    if (!placeholder_)
+        return allocated();
+    return (async_ != 0 && async_->finished());
 }
 
-void logpolarTransform::RCdeAllocateC2LTable ()
-{
-    if (c2lTable) {
-        delete[] c2lTable[0].position; // iweight is contiguous to position.
-        delete[] c2lTable;
+bool logpolarTransform::upgradeLookupTables() {
+    //
+    if (!placeholder_)
+        return allocated();
+
+    if (async_ == 0 || !async_->finished())
+        return false;
+
+    async_->stop();
+    if (async_->ok) {
+        // move the exact tables in, the placeholder goes.
+        logpolarTransform *t = async_->staging;
+        if (c2lTable) RCdeAllocateC2LTable ();
+        if (l2cOffset) RCdeAllocateL2CTable ();
+        c2lTable = t->c2lTable;
+        c2lPacked_ = t->c2lPacked_;
+        c2lReplica_ = t->c2lReplica_;
+        nReplicas_ = t->nReplicas_;
+        l2cOffset = t->l2cOffset;
+        l2cPaged_ = t->l2cPaged_;
+        l2cTaps16 = t->l2cTaps16;
+        l2cTaps32 = t->l2cTaps32;
+        l2cSpan = t->l2cSpan;
+        l2cRow = t->l2cRow;
+        t->c2lTable = 0;
+        t->c2lPacked_ = false;
+        t->c2lReplica_ = 0;
+        t->nReplicas_ = 0;
+        t->l2cOffset = 0;
+        t->l2cPaged_ = false;
+        t->l2cTaps16 = 0;
+        t->l2cTaps32 = 0;
+        t->l2cSpan = 0;
+        t->l2cRow = 0;
+        placeholder_ = false;
     }
-    c2lTable = 0;
+    else
+        cerr << "logPolarLibrary: can't build the lookup tables, the placeholder is kept" << endl;
+
+    delete async_;
+    async_ = 0;
+    return !placeholder_;
 }
 
-void logpolarTransform::RCdeAllocateL2CTable ()
-{
-    if (l2cTable) {
-        delete[] l2cTable[0].position;
-        delete[] l2cTable;
+bool logpolarTransform::waitLookupTables() {
+    //
+    // joins the builder, the build itself isn't interrupted.
+    if (async_ != 0) {
+        async_->stop();
+        return upgradeLookupTables();
     }
-    l2cTable = 0;
-}
 
-double logpolarTransform::RCgetLogIndex ()
-{
-    double logIndex;
-    logIndex = (1.0 + sin (PI / nang_)) / (1.0 - sin (PI / nang_));
-    return logIndex;
+    // the builder couldn't start, the exact tables are built here.
+    if (placeholder_) {
+        const int mode = mode_, necc = necc_, nang = nang_, w = width_, h = height_;
+        const double overlap = overlap_;
+        freeLookupTables();
+        return allocLookupTables(mode, necc, nang, w, h, overlap);
+    }
+    return allocated();
 }
 
-double logpolarTransform::RCcomputeScaleFactor ()
-{
-    double maxRad;
-    double receptFieldRadius;
-    double r0;
-    double lambda;
-    int fov;
-	int cSize = width_;
-	
-	if (width_ > height_)
-		cSize = height_;
+bool logpolarTransform::packLookupTables(logpolarPackedTables& tables) {
+    //
+    if (!allocated() || placeholder_) {
+        cerr << "logPolarLibrary: no exact lookup tables to pack" << endl;
+        return false;
+    }
 
-    double totalRadius;
-    double angle = (2.0 * PI / nang_);   // Angular size of one pixel
-    double sinus = sin (angle / 2.0);
+    tables = logpolarPackedTables();
 
-    lambda = (1.0 + sinus) / (1.0 - sinus);
-    fov = (int) (lambda / (lambda - 1));
-    r0 = 1.0 / (pow (lambda, fov) * (lambda - 1));
+    if (c2lTable != 0) {
+        if (!RCbuildRings (0, necc_))
+            return false;
 
-    maxRad = pow (lambda, necc_ - 1) * (r0 + 0.5 / pow (lambda, fov));
+        const int n = necc_ * nang_;
+        tables.c2lOffset.resize(n + 1);
+        unsigned int taps = 0;
+        for (int i = 0; i < n; i++) {
+            tables.c2lOffset[i] = taps;
+            taps += c2lTable[i].divisor;
+        }
+        tables.c2lOffset[n] = taps;
+
+        tables.c2lPosition.reserve(taps);
+        tables.c2lWeight.reserve(taps);
+        for (int i = 0; i < n; i++) {
+            const cart2LpPixel& e = c2lTable[i];
+            tables.c2lPosition.insert(tables.c2lPosition.end(), e.position, e.position + e.divisor);
+            tables.c2lWeight.insert(tables.c2lWeight.end(), e.iweight, e.iweight + e.divisor);
+        }
+    }
 
-    receptFieldRadius = maxRad * 2.0 * sinus * (overlap_ + 1.0) / (2.0);
-    totalRadius = maxRad + receptFieldRadius;
-    totalRadius = (cSize / 2) / totalRadius;
-    return totalRadius;
+    if (l2cOffset != 0) {
+        const int covered = l2cRow[height_];
+        const unsigned int taps = l2cOffset[covered];
+        tables.l2cSpan.assign(l2cSpan, l2cSpan + 2 * height_);
+        tables.l2cRow.assign(l2cRow, l2cRow + height_ + 1);
+        tables.l2cOffset.assign(l2cOffset, l2cOffset + covered + 1);
+        if (l2cTaps16)
+            tables.l2cTaps.assign(l2cTaps16, l2cTaps16 + taps);
+        else
+            tables.l2cTaps.assign(l2cTaps32, l2cTaps32 + taps);
+    }
+    return true;
 }
 
-int logpolarTransform::RCbuildC2LMap (double scaleFact, int mode, int padding)
-{
-    // store map in c2lTable which is supposedly already allocated (while the internal arrays are allocated on the fly).
-
-    if (overlap_ <= -1.0) {
-        cerr << "logpolarTransform: overlap must be greater than -1" << endl;
-        return 1;
+bool logpolarTransform::cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
+                                       const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart) {
+    if (!(mode_ & C2L)) {
+        cerr << "logPolarLibrary: conversion to logpolar called with wrong mode set" << endl;
+        return false;
     }
 
-    int cSize = width_;
-
-    if (width_ > height_)
-        cSize = height_;
+    if (!RCbuildRings (0, necc_))
+        return false;
 
-    const double precision = 10.0;
-    double angle = (2.0 * PI / nang_);   // Angular size of one pixel
-    double sinus = sin (angle / 2.0);
-    double tangent = sinus / cos (angle / 2.0);
+    // LATER: assert whether lp & cart are effectively nang * necc as the c2lTable requires.
+    RCgetLpImg (lp.getRawImage(), (unsigned char *)cart.getRawImage(), RCnodeTable (), lp.getPadding(), 0, necc_);
+    return true;
+}
 
-    int fov;
-    int lim;
+bool logpolarTransform::cartToLogpolar(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
+                                       const yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                                       int firstRing, int lastRing) {
+    if (!(mode_ & C2L)) {
+        cerr << "logPolarLibrary: conversion to logpolar called with wrong mode set" << endl;
+        return false;
+    }
 
-    double lambda;              // Log Index
-    double firstRing;           // Diameter of the receptive fields in the first ring when overlap is 0
-    double *currRad;            // Distance of the center of the current ring RF's from the center of the mapping
-    double *nextRad;            // Distance of the center of the next ring's RF's from the center of the mapping
-    double r0;                  // lower limit of RF0 in the "pure" log polar mapping
+    if (firstRing < 0) firstRing = 0;
+    if (lastRing > necc_) lastRing = necc_;
+    if (firstRing >= lastRing)
+        return true;
 
-    double x0, y0;
-    double locX, locY, locRad;
-    double *radii;
-    double *tangaxis;
-    double *radialaxis;
-    double *focus;
-    double *radii2;
-    double A;
-    double L;
-    double step;
-    double F0x, F0y, F1x, F1y;
-    double maxaxis;
+    if (!RCbuildRings (firstRing, lastRing))
+        return false;
 
-    int rho, theta, j, sz;
+    RCgetLpImg (lp.getRawImage(), (unsigned char *)cart.getRawImage(), RCnodeTable (), lp.getPadding(), firstRing, lastRing);
+    return true;
+}
 
-    double *sintable;
-    double *costable;
-    int intx, inty;
-    bool found;
-    int mapsize;
-    float *weight;
+bool logpolarTransform::RCbuildRings (int firstRing, int lastRing) {
+    //
+    // once all the rings are built the conversions don't take any lock.
+    if (lazyGeometry_ == 0 || loadAcquire (&allRingsBuilt_))
+        return true;
+
+    // each ring has its own lock: conversions of disjoint ranges build their rings
+    // concurrently, a conversion waits only for the rings it needs being built by another one.
+    bool ok = true;
+    buildArena scratch;
+    for (int rho = firstRing; rho < lastRing && ok; rho++) {
+        ringLock_[rho].wait();
+        if (!ringBuilt_[rho]) {
+            ok = (RCbuildC2LRing (*lazyGeometry_, rho, PAD_BYTES(width_*3, YARP_IMAGE_ALIGN), 0, scratch) == 0);
+            ringBuilt_[rho] = ok;
+            if (ok) {
+                ringMutex_.wait();
+                if (--ringsLeft_ == 0)
+                    storeRelease (&allRingsBuilt_, 1);
+                ringMutex_.post();
+            }
+        }
+        ringLock_[rho].post();
+    }
+    return ok;
+}
+
+bool logpolarTransform::logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp) {
+    if (!(mode_ & L2C)) {
+        cerr << "logPolarLibrary: conversion to cartesian called with wrong mode set" << endl;
+        return false;
+    }
+
+    // LATER: assert whether lp & cart are effectively of the correct size.
+    RCgetCartImg (cart.getRawImage(), lp.getRawImage(), cart.getPadding(), 0, height_);
+
+    return true;
+}
+
+bool logpolarTransform::logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                            int firstRow, int lastRow) {
+    if (!(mode_ & L2C)) {
+        cerr << "logPolarLibrary: conversion to cartesian called with wrong mode set" << endl;
+        return false;
+    }
+
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow > height_) lastRow = height_;
+    if (firstRow >= lastRow)
+        return true;
+
+    RCgetCartImg (cart.getRawImage(), lp.getRawImage(), cart.getPadding(), firstRow, lastRow);
+
+    return true;
+}
+
+bool logpolarTransform::logpolarToCartRoi(yarp::sig::ImageOf<yarp::sig::PixelRgb>& roi,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                            int x0, int y0, int w, int h) {
+    if (!(mode_ & L2C)) {
+        cerr << "logPolarLibrary: conversion to cartesian called with wrong mode set" << endl;
+        return false;
+    }
+
+    if (w <= 0 || h <= 0) {
+        cerr << "logPolarLibrary: empty region of interest" << endl;
+        return false;
+    }
+
+    roi.resize(w, h);
+    RCgetCartImgRoi (roi, lp.getRawImage(), x0, y0);
+
+    return true;
+}
+
+bool logpolarTransform::logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                            const foveaBlendMask& mask) {
+    return logpolarToCart(cart, lp, fovea, mask, 0, height_);
+}
+
+bool logpolarTransform::logpolarToCart(yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp,
+                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                            const foveaBlendMask& mask,
+                            int firstRow, int lastRow) {
+    if (!(mode_ & L2C)) {
+        cerr << "logPolarLibrary: conversion to cartesian called with wrong mode set" << endl;
+        return false;
+    }
+
+    // checked on every frame, the caller reports it.
+    if (mask.size == 0 || fovea.width() != mask.fovea || fovea.height() != mask.fovea)
+        return false;
+
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow > height_) lastRow = height_;
+    if (firstRow >= lastRow)
+        return true;
+
+    RCgetCartImgFovea (cart, lp.getRawImage(), fovea, mask, firstRow, lastRow);
+
+    return true;
+}
+
+// internal implementation of the logpolarTransform class.
+
+inline double __max64f (double x, double y) {
+    return (x > y) ? x : y;
+}
+
+// analytic coverage of the receptive fields.
+
+// a receptive field, in the coordinates of the sampling (origin at the centre of the mapping):
+// the centre, the direction of the major axis and the two semi-axes.
+struct rfEllipse {
+    double x0, y0;
+    double ux, uy;
+    double a, b;
+};
+
+static void makeEllipse (rfEllipse& e, double x0, double y0, double focus, double sint, double cost, double maxaxis)
+{
+    e.x0 = x0;
+    e.y0 = y0;
+    if (focus >= 0) {
+        e.ux = -sint;
+        e.uy = cost;
+    }
+    else {
+        e.ux = cost;
+        e.uy = sint;
+    }
+    e.a = maxaxis;
+    const double b2 = maxaxis * maxaxis - focus * focus;
+    e.b = (b2 > 0) ? sqrt (b2) : 0;
+}
+
+// signed area of the intersection of the unit disc with the triangle (0, p, q).
+static double discTriangleArea (double px, double py, double qx, double qy)
+{
+    const double dx = qx - px;
+    const double dy = qy - py;
+    const double A = dx * dx + dy * dy;
+    const double B = px * dx + py * dy;
+    const double C = px * px + py * py - 1.0;
+    const double disc = B * B - A * C;
+
+    if (A <= 0)
+        return 0;
+
+    if (disc > 0) {
+        const double s = sqrt (disc);
+        double t1 = (-B - s) / A;
+        double t2 = (-B + s) / A;
+        if (t2 > 0 && t1 < 1) {
+            // the edge crosses the circle: sector, triangle, sector.
+            if (t1 < 0) t1 = 0;
+            if (t2 > 1) t2 = 1;
+            const double ax = px + t1 * dx, ay = py + t1 * dy;
+            const double bx = px + t2 * dx, by = py + t2 * dy;
+            return 0.5 * (atan2 (px * ay - py * ax, px * ax + py * ay) +
+                          (ax * by - ay * bx) +
+                          atan2 (bx * qy - by * qx, bx * qx + by * qy));
+        }
+    }
+
+    // the edge is outside the circle: the sector alone.
+    return 0.5 * atan2 (px * qy - py * qx, px * qx + py * qy);
+}
+
+// area of the pixel [px, px+1) x [py, py+1) (relative to the centre of e) covered by e. The
+// ellipse is mapped onto the unit circle, the pixel onto a parallelogram.
+static double ellipsePixelArea (const rfEllipse& e, double px, double py)
+{
+    const double cx[4] = { px, px + 1, px + 1, px };
+    const double cy[4] = { py, py, py + 1, py + 1 };
+    double tx[4], ty[4];
+
+    for (int i = 0; i < 4; i++) {
+        tx[i] = (cx[i] * e.ux + cy[i] * e.uy) / e.a;
+        ty[i] = (cy[i] * e.ux - cx[i] * e.uy) / e.b;
+    }
+
+    double area = 0;
+    for (int i = 0; i < 4; i++)
+        area += discTriangleArea (tx[i], ty[i], tx[(i+1)%4], ty[(i+1)%4]);
+
+    return fabs (area) * e.a * e.b;
+}
+
+// the pixels of a width by height image covered by e (for more than eps), row by row. pixels
+// receives y*width+x, areas the covered area. The buffers hold the bounding box of e. Without
+// weights only the pixels with no corner inside e are measured and areas isn't filled.
+// @return the number of pixels.
+static int rasterizeEllipse (const rfEllipse& e, int width, int height, double eps, bool weights, int *pixels, double *areas)
+{
+    const int hx = width / 2;
+    const int hy = height / 2;
+    int n = 0;
+
+    if (e.a < 1e-9 || e.b < 1e-9) {
+        const int x = (int) floor (e.x0 + hx);
+        const int y = (int) floor (e.y0 + hy);
+        if (x >= 0 && x < width && y >= 0 && y < height) {
+            pixels[0] = y * width + x;
+            if (weights) areas[0] = 1.0;
+            return 1;
+        }
+        return 0;
+    }
+
+    // the ellipse as A x^2 + B x y + C y^2 <= 1 and its extent.
+    const double ia2 = 1.0 / (e.a * e.a);
+    const double ib2 = 1.0 / (e.b * e.b);
+    const double A = e.ux * e.ux * ia2 + e.uy * e.uy * ib2;
+    const double B = 2.0 * e.ux * e.uy * (ia2 - ib2);
+    const double C = e.uy * e.uy * ia2 + e.ux * e.ux * ib2;
+    const double ex = sqrt (e.a * e.a * e.ux * e.ux + e.b * e.b * e.uy * e.uy);
+    const double ey = sqrt (e.a * e.a * e.uy * e.uy + e.b * e.b * e.ux * e.ux);
+    const double yRight = -B * ex / (2.0 * C);
+
+    int firstRow = (int) floor (e.y0 - ey + hy);
+    int lastRow = (int) floor (e.y0 + ey + hy);
+    if (firstRow < 0) firstRow = 0;
+    if (lastRow > height - 1) lastRow = height - 1;
+
+    for (int y = firstRow; y <= lastRow; y++) {
+        const double py = y - hy - e.y0;
+
+        // the columns spanned by the ellipse within the row.
+        double ya = (py > -ey) ? py : -ey;
+        double yb = (py + 1 < ey) ? py + 1 : ey;
+        if (ya > yb)
+            continue;
+
+        double xlo, xhi;
+        if (ya <= -yRight && -yRight <= yb)
+            xlo = -ex;
+        else {
+            const double la = (-B * ya - sqrt (__max64f (B * B * ya * ya - 4.0 * A * (C * ya * ya - 1.0), 0))) / (2.0 * A);
+            const double lb = (-B * yb - sqrt (__max64f (B * B * yb * yb - 4.0 * A * (C * yb * yb - 1.0), 0))) / (2.0 * A);
+            xlo = (la < lb) ? la : lb;
+        }
+        if (ya <= yRight && yRight <= yb)
+            xhi = ex;
+        else {
+            const double ra = (-B * ya + sqrt (__max64f (B * B * ya * ya - 4.0 * A * (C * ya * ya - 1.0), 0))) / (2.0 * A);
+            const double rb = (-B * yb + sqrt (__max64f (B * B * yb * yb - 4.0 * A * (C * yb * yb - 1.0), 0))) / (2.0 * A);
+            xhi = __max64f (ra, rb);
+        }
+
+        int first = (int) floor (xlo + e.x0 + hx);
+        int last = (int) floor (xhi + e.x0 + hx);
+        if (first < 0) first = 0;
+        if (last > width - 1) last = width - 1;
+
+        for (int x = first; x <= last; x++) {
+            const double px = x - hx - e.x0;
+
+            // pixels with the four corners inside are covered entirely (the ellipse is convex).
+            int inside = 0;
+            for (int k = 0; k < 4; k++) {
+                const double qx = px + (k & 1);
+                const double qy = py + (k >> 1);
+                if (A * qx * qx + B * qx * qy + C * qy * qy <= 1.0)
+                    inside++;
+            }
+
+            if (!weights && inside > 0) {
+                pixels[n++] = y * width + x;
+                continue;
+            }
+
+            const double area = (inside == 4) ? 1.0 : ellipsePixelArea (e, px, py);
+            if (area > eps) {
+                pixels[n] = y * width + x;
+                if (weights) areas[n] = area;
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+// the area below which the coverage of a pixel is negligible.
+static double coverageTolerance (const rfEllipse& e)
+{
+    const double area = PI * e.a * e.b;
+    return 1e-3 * ((area < 1.0) ? area : 1.0);
+}
+
+void logpolarTransform::RCdeAllocateC2LTable ()
+{
+    if (c2lReplica_) {
+        for (int i = 0; i < nReplicas_; i++)
+            freeTablePages (c2lReplica_[i]);
+        delete[] c2lReplica_;
+    }
+    c2lReplica_ = 0;
+    nReplicas_ = 0;
+
+    if (c2lPacked_)
+        freeTablePages (c2lTable);
+    else
+    if (c2lTable) {
+        // one block per ring, iweight is contiguous to position. Lazy rings might not be built.
+        for (int rho = 0; rho < necc_; rho++)
+            if (c2lTable[rho * nang_].position) delete[] c2lTable[rho * nang_].position;
+        delete[] c2lTable;
+    }
+    c2lTable = 0;
+    c2lPacked_ = false;
+    if (lazyGeometry_) delete lazyGeometry_;
+    lazyGeometry_ = 0;
+    if (ringBuilt_) delete[] ringBuilt_;
+    ringBuilt_ = 0;
+    if (ringLock_) delete[] ringLock_;
+    ringLock_ = 0;
+    ringsLeft_ = 0;
+    allRingsBuilt_ = 0;
+}
+
+void logpolarTransform::RCdeAllocateL2CTable ()
+{
+    if (l2cPaged_) {
+        freeTablePages (l2cOffset);
+        freeTablePages (l2cTaps16);
+        freeTablePages (l2cTaps32);
+    }
+    else {
+        if (l2cOffset) delete[] l2cOffset;
+        if (l2cTaps16) delete[] l2cTaps16;
+        if (l2cTaps32) delete[] l2cTaps32;
+    }
+    l2cOffset = 0;
+    l2cTaps16 = 0;
+    l2cTaps32 = 0;
+    l2cPaged_ = false;
+    if (l2cSpan) delete[] l2cSpan;
+    l2cSpan = 0;
+    if (l2cRow) delete[] l2cRow;
+    l2cRow = 0;
+}
+
+cart2LpPixel *logpolarTransform::RCpackC2LTable (int node)
+{
+    // the entries first, then the positions and the weights of all of them.
+    const int n = necc_ * nang_;
+    size_t taps = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        taps += c2lTable[i].divisor;
+
+    cart2LpPixel *packed = (cart2LpPixel *) allocTablePages (n * sizeof(cart2LpPixel) + 2 * taps * sizeof(int), pages_, node);
+    if (packed == 0)
+        return 0;
+
+    int *position = (int *)(packed + n);
+    int *iweight = position + taps;
+    for (i = 0; i < n; i++) {
+        const int div = c2lTable[i].divisor;
+        packed[i].divisor = div;
+        packed[i].position = position;
+        packed[i].iweight = iweight;
+        memcpy (position, c2lTable[i].position, div * sizeof(int));
+        memcpy (iweight, c2lTable[i].iweight, div * sizeof(int));
+        position += div;
+        iweight += div;
+    }
+    return packed;
+}
+
+bool logpolarTransform::RCplaceTables ()
+{
+    if (pages_ == PAGES_DEFAULT && !numa_)
+        return true;
+
+    // the lazy tables are built ring by ring, they stay where they are.
+    if (c2lTable != 0 && !c2lPacked_ && lazyGeometry_ == 0) {
+        cart2LpPixel *packed = RCpackC2LTable (-1);
+        if (packed == 0)
+            return false;
+        RCdeAllocateC2LTable ();
+        c2lTable = packed;
+        c2lPacked_ = true;
+
+        // a copy per node, the conversions read the one of the node they run on.
+        const int nodes = (numa_) ? countNumaNodes () : 1;
+        if (nodes > 1) {
+            c2lReplica_ = new cart2LpPixel *[nodes];
+            nReplicas_ = nodes;
+            for (int i = 0; i < nodes; i++)
+                c2lReplica_[i] = RCpackC2LTable (i);
+        }
+    }
+
+    if (l2cOffset != 0 && !l2cPaged_ && pages_ != PAGES_DEFAULT) {
+        // the span and row indices are tiny, the offsets and the taps move.
+        const int covered = l2cRow[height_];
+        const size_t tapSize = (l2cTaps16) ? sizeof(unsigned short) : sizeof(unsigned int);
+        const size_t taps = l2cOffset[covered];
+        unsigned int *offset = (unsigned int *) allocTablePages ((covered + 1) * sizeof(unsigned int), pages_, -1);
+        void *tap = allocTablePages ((taps > 0 ? taps : 1) * tapSize, pages_, -1);
+        if (offset == 0 || tap == 0) {
+            freeTablePages (offset);
+            freeTablePages (tap);
+            return false;
+        }
+
+        memcpy (offset, l2cOffset, (covered + 1) * sizeof(unsigned int));
+        delete[] l2cOffset;
+        l2cOffset = offset;
+        if (l2cTaps16) {
+            memcpy (tap, l2cTaps16, taps * tapSize);
+            delete[] l2cTaps16;
+            l2cTaps16 = (unsigned short *)tap;
+        }
+        else {
+            memcpy (tap, l2cTaps32, taps * tapSize);
+            delete[] l2cTaps32;
+            l2cTaps32 = (unsigned int *)tap;
+        }
+        l2cPaged_ = true;
+    }
+    return true;
+}
+
+cart2LpPixel *logpolarTransform::RCnodeTable ()
+{
+    if (c2lReplica_ != 0) {
+        const int node = currentNumaNode ();
+        if (node >= 0 && node < nReplicas_ && c2lReplica_[node] != 0)
+            return c2lReplica_[node];
+    }
+    return c2lTable;
+}
+
+double logpolarTransform::RCgetLogIndex ()
+{
+    double logIndex;
+    logIndex = (1.0 + sin (PI / nang_)) / (1.0 - sin (PI / nang_));
+    return logIndex;
+}
+
+double logpolarTransform::RCcomputeScaleFactor ()
+{
+    double maxRad;
+    double receptFieldRadius;
+    double r0;
+    double lambda;
+    int fov;
+	int cSize = width_;
+	
+	if (width_ > height_)
+		cSize = height_;
+
+    double totalRadius;
+    double angle = (2.0 * PI / nang_);   // Angular size of one pixel
+    double sinus = sin (angle / 2.0);
 
-    // intiialization starts more or less here.
     lambda = (1.0 + sinus) / (1.0 - sinus);
     fov = (int) (lambda / (lambda - 1));
-    firstRing = (1.0 / (lambda - 1)) - (int) (1.0 / (lambda - 1));
     r0 = 1.0 / (pow (lambda, fov) * (lambda - 1));
 
-    // main table pointer (temporary).
-    cart2LpPixel *table = c2lTable;
+    maxRad = pow (lambda, necc_ - 1) * (r0 + 0.5 / pow (lambda, fov));
 
-    // temporary.
-    tangaxis = new double[necc_];
-    radialaxis = new double[necc_];
-    focus = new double[necc_];
-    radii2 = new double[necc_];
-    currRad = new double[necc_];
-    nextRad = new double[necc_];
+    receptFieldRadius = maxRad * 2.0 * sinus * (overlap_ + 1.0) / (2.0);
+    totalRadius = maxRad + receptFieldRadius;
+    totalRadius = (cSize / 2) / totalRadius;
+    return totalRadius;
+}
 
-    if ((tangaxis == 0) || (radialaxis == 0) || (focus == 0) || (radii2 == 0) || (currRad == 0) || (nextRad == 0))
-        goto C2LAllocError;
+int logpolarTransform::RCcomputeRFGeometry (rfGeometry& g, double scaleFact, int mode)
+{
+    if (overlap_ <= -1.0) {
+        cerr << "logpolarTransform: overlap must be greater than -1" << endl;
+        return 1;
+    }
+
+    double angle = (2.0 * PI / nang_);   // Angular size of one pixel
+    double sinus = sin (angle / 2.0);
+    double tangent = sinus / cos (angle / 2.0);
+    int fov;                    // Number of rings in fovea
+
+    double lambda;              // Log Index
+    double firstRing;           // Diameter of the receptive fields in the first ring when overlap is 0
+    double *nextRad;            // Distance of the center of the next ring's RF's from the center of the mapping
+    double r0;                  // lower limit of RF0 in the "pure" log polar mapping
+    double A;
+    double L;
+    int rho, j;
+
+    lambda = (1.0 + sinus) / (1.0 - sinus);
+    fov = (int) (lambda / (lambda - 1));
+    firstRing = (1.0 / (lambda - 1)) - (int) (1.0 / (lambda - 1));
+    r0 = 1.0 / (pow (lambda, fov) * (lambda - 1));
+
+    g.mode = mode;
+    g.necc = necc_;
+    g.nang = nang_;
+    g.scaleFact = scaleFact;
+    if (!g.arena.reserve ((5 * necc_ + 2 * nang_) * sizeof(double) + necc_ * sizeof(int) + 8 * 16)) {
+        cerr << "logpolarTransform: memory allocation issue, no tables generated" << endl;
+        return 2;
+    }
+    g.currRad = g.arena.alloc<double>(necc_);
+    g.tangaxis = g.arena.alloc<double>(necc_);
+    g.radialaxis = g.arena.alloc<double>(necc_);
+    g.focus = g.arena.alloc<double>(necc_);
+    g.sintable = g.arena.alloc<double>(nang_);
+    g.costable = g.arena.alloc<double>(nang_);
+    g.lim = g.arena.alloc<int>(necc_);
+    nextRad = g.arena.alloc<double>(necc_);
 
     /************************
      * RF's size Computation *
@@ -323,129 +1311,314 @@ int logpolarTransform::RCbuildC2LMap (double scaleFact, int mode, int padding)
     for (rho = 0; rho < necc_; rho++) {
         if (rho < fov)
             if (rho == 0) {
-                currRad[rho] = firstRing * 0.5;
+                g.currRad[rho] = firstRing * 0.5;
                 nextRad[rho] = firstRing;
             }
             else {
-                currRad[rho] = rho + firstRing - 0.5;
-                nextRad[rho] = currRad[rho] + 1.0;
+                g.currRad[rho] = rho + firstRing - 0.5;
+                nextRad[rho] = g.currRad[rho] + 1.0;
             }
         else {
-            currRad[rho] = pow (lambda, rho) * (r0 + 0.5 / pow (lambda, fov));
-            nextRad[rho] = lambda * currRad[rho];
+            g.currRad[rho] = pow (lambda, rho) * (r0 + 0.5 / pow (lambda, fov));
+            nextRad[rho] = lambda * g.currRad[rho];
         }
-        tangaxis[rho] =
-            scaleFact * 2.0 * currRad[rho] * sinus * (overlap_ + 1.0) / (2.0);
 
-        radialaxis[rho] =
-            scaleFact * (nextRad[rho] - currRad[rho]) * (overlap_ + 1.0);
+        g.tangaxis[rho] =
+            scaleFact * 2.0 * g.currRad[rho] * sinus * (overlap_ + 1.0) / (2.0);
+
+        g.radialaxis[rho] =
+            scaleFact * (nextRad[rho] - g.currRad[rho]) * (overlap_ + 1.0);
 
         if (rho < fov)
-            radialaxis[rho] /= 2.0;
+            g.radialaxis[rho] /= 2.0;
         else
-            radialaxis[rho] /= (1.0 + lambda);
+            g.radialaxis[rho] /= (1.0 + lambda);
 
         if ((rho < fov) && (mode == ELLIPTICAL)) {
-            A = radialaxis[rho] * radialaxis[rho];
-            L = scaleFact * currRad[rho] * (overlap_ + 1.0);
+            A = g.radialaxis[rho] * g.radialaxis[rho];
+            L = scaleFact * g.currRad[rho] * (overlap_ + 1.0);
             L = L * L;
-            tangaxis[rho] = tangent * sqrt (L - A);
+            g.tangaxis[rho] = tangent * sqrt (L - A);
         }
     }
-    radialaxis[0] = 0.5 * scaleFact * (firstRing) * (overlap_ + 1.0);
+    g.radialaxis[0] = 0.5 * scaleFact * (firstRing) * (overlap_ + 1.0);
 
     if (mode == RADIAL)
-        radii = radialaxis;
+        g.radii = g.radialaxis;
     else
-        radii = tangaxis;
+        g.radii = g.tangaxis;
 
     for (rho = 0; rho < necc_; rho++) {
         if (mode != ELLIPTICAL)
-            focus[rho] = 0;
+            g.focus[rho] = 0;
         else {
-            focus[rho] =
-                -sqrt (fabs (radialaxis[rho] * radialaxis[rho] -
-                             tangaxis[rho] * tangaxis[rho]));
+            g.focus[rho] =
+                -sqrt (fabs (g.radialaxis[rho] * g.radialaxis[rho] -
+                             g.tangaxis[rho] * g.tangaxis[rho]));
         }
 
-        if (tangaxis[rho] >= radialaxis[rho])
-            focus[rho] = -focus[rho];
+        if (g.tangaxis[rho] >= g.radialaxis[rho])
+            g.focus[rho] = -g.focus[rho];
 
-        radii2[rho] = radii[rho] * radii[rho];
+        if ((mode == RADIAL) || (mode == TANGENTIAL))
+            g.lim[rho] = (int) (g.radii[rho] + 1.5);
+        else
+            g.lim[rho] = (int) (__max64f (g.tangaxis[rho], g.radialaxis[rho]) + 1.5);
     }
 
-    sintable = new double[nang_];
-    costable = new double[nang_];
+    for (j = 0; j < nang_; j++) {
+        g.sintable[j] = sin (angle * (j + 0.5));
+        g.costable[j] = cos (angle * (j + 0.5));
+    }
 
-    if ((sintable == 0) || (costable == 0))
-        goto C2LAllocError;
+    return 0;
+}
 
-    for (j = 0; j < nang_; j++) {
-        sintable[j] = sin (angle * (j + 0.5));
-        costable[j] = cos (angle * (j + 0.5));
+int logpolarTransform::RCbuildPlaceholderMaps (const rfGeometry& g, int mode, int c2lPadding, int l2cPadding)
+{
+    int rho, theta, i, j;
+
+    if (mode & C2L) {
+        // each receptive field takes the pixel at its center, one block per ring.
+        c2lTable = new cart2LpPixel[necc_ * nang_];
+        if (c2lTable == 0)
+            return 2;
+        memset (c2lTable, 0, necc_ * nang_ * sizeof(cart2LpPixel));
+
+        for (rho = 0; rho < necc_; rho++) {
+            int *block = new int[2 * nang_];
+            if (block == 0) {
+                RCdeAllocateC2LTable ();
+                return 2;
+            }
+
+            for (theta = 0; theta < nang_; theta++) {
+                const int k = rho * nang_ + theta;
+                int x = (int) floor (g.scaleFact * g.currRad[rho] * g.costable[theta] + width_ / 2);
+                int y = (int) floor (g.scaleFact * g.currRad[rho] * g.sintable[theta] + height_ / 2);
+                x = (x < 0) ? 0 : ((x >= width_) ? width_ - 1 : x);
+                y = (y < 0) ? 0 : ((y >= height_) ? height_ - 1 : y);
+
+                c2lTable[k].divisor = 1;
+                c2lTable[k].position = block + theta;
+                c2lTable[k].iweight = block + nang_ + theta;
+                c2lTable[k].position[0] = y * (3 * width_ + c2lPadding) + 3 * x;
+                c2lTable[k].iweight[0] = 65536;
+            }
+        }
     }
 
-    // compute overall table size for contiguous allocation (position & weigth).
-    sz = 0;
-    for (rho = 0; rho < necc_; rho++) {
-        if ((mode == RADIAL) || (mode == TANGENTIAL))
-            lim = (int) (radii[rho] + 1.5);
+    if (mode & L2C) {
+        // each pixel within the outer ring takes the closest receptive field.
+        const double outer = g.scaleFact * g.currRad[necc_-1] + g.radialaxis[necc_-1];
+        const double sector = 2.0 * PI / nang_;
+        buildArena scratch;
+        int *field = scratch.alloc<int>(width_ * height_);
+        l2cSpan = new int[2 * height_];
+        l2cRow = new int[height_ + 1];
+        if (field == 0 || l2cSpan == 0 || l2cRow == 0) {
+            RCdeAllocateL2CTable ();
+            return 2;
+        }
+
+        int covered = 0;
+        for (i = 0; i < height_; i++) {
+            const double y = i + 0.5 - height_ / 2;
+            int first = width_, last = 0;
+            for (j = 0; j < width_; j++) {
+                const double x = j + 0.5 - width_ / 2;
+                const double r = sqrt (x * x + y * y);
+                field[i * width_ + j] = -1;
+                if (r > outer)
+                    continue;
+
+                double a = atan2 (y, x);
+                if (a < 0) a += 2.0 * PI;
+                theta = (int) (a / sector);
+                if (theta >= nang_) theta = nang_ - 1;
+
+                // the rings are sorted by radius.
+                int lo = 0, hi = necc_ - 1;
+                while (lo < hi) {
+                    const int mid = (lo + hi) / 2;
+                    if (g.scaleFact * g.currRad[mid] < r)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                rho = lo;
+                if (rho > 0 && r - g.scaleFact * g.currRad[rho-1] < g.scaleFact * g.currRad[rho] - r)
+                    rho--;
+
+                field[i * width_ + j] = rho * nang_ + theta;
+                if (j < first) first = j;
+                last = j + 1;
+            }
+            if (first >= last)
+                first = last = 0;
+            l2cSpan[2*i] = first;
+            l2cSpan[2*i+1] = last;
+            l2cRow[i] = covered;
+            covered += last - first;
+        }
+        l2cRow[height_] = covered;
+
+        // one tap per pixel, the pixels within the spans but beyond the outer ring have none.
+        const int maxTap = 3 * (necc_ * nang_ - 1) + l2cPadding * (necc_ - 1);
+        l2cOffset = new unsigned int[covered + 1];
+        if (maxTap < 65536)
+            l2cTaps16 = new unsigned short[(covered > 0) ? covered : 1];
         else
-            lim = (int) (__max64f (tangaxis[rho], radialaxis[rho]) + 1.5);
+            l2cTaps32 = new unsigned int[(covered > 0) ? covered : 1];
+        if (l2cOffset == 0 || (l2cTaps16 == 0 && l2cTaps32 == 0)) {
+            RCdeAllocateL2CTable ();
+            return 2;
+        }
 
-        step = lim / precision;
-        if (step > 1) step = 1;
+        unsigned int taps = 0;
+        for (i = 0; i < height_; i++) {
+            for (j = l2cSpan[2*i]; j < l2cSpan[2*i+1]; j++) {
+                const int k = field[i * width_ + j];
+                l2cOffset[l2cRow[i] + j - l2cSpan[2*i]] = taps;
+                if (k < 0)
+                    continue;
+
+                const int tap = 3 * k + l2cPadding * (k / nang_);
+                if (l2cTaps16)
+                    l2cTaps16[taps] = (unsigned short)tap;
+                else
+                    l2cTaps32[taps] = (unsigned int)tap;
+                taps++;
+            }
+        }
+        l2cOffset[covered] = taps;
+    }
 
-        mapsize = (int) (precision * lim * precision * lim + 1);
-        sz += (mapsize * nang_);
+    return 0;
+}
+
+int logpolarTransform::RCbuildC2LMap (const rfGeometry& g, int padding, rfCoverage *cov, buildArena& scratch)
+{
+    // store map in c2lTable which is supposedly already allocated (while the internal arrays are allocated on the fly).
+    if (cov) {
+        cov->offset.resize(necc_ * nang_ + 1);
+        cov->offset[0] = 0;
+        cov->pixels.clear();
     }
 
-    table->position = new int[sz * 2];
-    if (table->position == 0)
-        goto C2LAllocError;
-    table->iweight = table->position + sz;
+    // the scratch of the largest ring, reused by all the rings.
+    int rho, maxLim = 0;
+    for (rho = 0; rho < necc_; rho++)
+        if (g.lim[rho] > maxLim)
+            maxLim = g.lim[rho];
+    if (!scratch.reserve (RCringScratchSize (maxLim))) {
+        cerr << "logpolarTransform: memory allocation issue, no tables generated" << endl;
+        return 2;
+    }
 
     for (rho = 0; rho < necc_; rho++) {
-        if ((mode == RADIAL) || (mode == TANGENTIAL))
-            lim = (int) (radii[rho] + 1.5);
-        else
-            lim = (int) (__max64f (tangaxis[rho], radialaxis[rho]) + 1.5);
+        if (RCbuildC2LRing (g, rho, padding, cov, scratch) != 0)
+            return 2;
+    }
 
-        step = lim / precision;
+    return 0;
+}
 
-        if (step > 1)
-            step = 1;
+int logpolarTransform::RCringScratchSize (int lim)
+{
+    const double precision = 10.0;
+    if (coverage_ == ANALYTIC)
+        return (2 * lim + 3) * (2 * lim + 3) * (sizeof(int) + sizeof(double)) + 32;
+    else
+        return ((int) (precision * lim * precision * lim + 1)) * sizeof(float) + 16;
+}
+
+int logpolarTransform::RCbuildC2LRing (const rfGeometry& g, int rho, int padding, rfCoverage *cov, buildArena& scratch)
+{
+    const double precision = 10.0;
+    const int lim = g.lim[rho];
+
+    double x0, y0;
+    double locX, locY, locRad;
+    double step;
+    double F0x, F0y, F1x, F1y;
+    double maxaxis;
+
+    int theta, j;
 
+    const int stride = 3 * width_ + padding;    // bytes per row of the cartesian image
+    int intx, inty;
+    bool found;
+    int mapsize;
+    float *weight = 0;
+    int *pixels = 0;            // analytic coverage: the pixels of a receptive field and their area.
+    double *areas = 0;
+    rfEllipse rf;
+
+    // the entries of the ring (position & weight) are allocated contiguously, the scratch
+    // comes from the arena and goes back to it when the ring is done.
+    cart2LpPixel *table = c2lTable + rho * nang_;
+    const buildArena::marker mark = scratch.mark();
+
+    if (coverage_ == ANALYTIC)
+        mapsize = (2 * lim + 3) * (2 * lim + 3);
+    else
         mapsize = (int) (precision * lim * precision * lim + 1);
-        weight = new float[mapsize];
-        if (weight == 0)
-            goto C2LAllocError;
 
-        for (theta = 0; theta < nang_; theta++) {
-            //
-            memset (table->position, 0, mapsize);
-            memset (weight, 0, mapsize);
+    table->position = new int[mapsize * nang_ * 2];
+    if (table->position == 0)
+        goto C2LAllocError;
+    table->iweight = table->position + mapsize * nang_;
 
-            x0 = scaleFact * currRad[rho] * costable[theta];
-            y0 = scaleFact * currRad[rho] * sintable[theta];
+    step = lim / precision;
+    if (step > 1)
+        step = 1;
+
+    if (coverage_ == ANALYTIC) {
+        areas = scratch.alloc<double>(mapsize);
+        pixels = scratch.alloc<int>(mapsize);
+        if (pixels == 0 || areas == 0)
+            goto C2LAllocError;
+    }
+    else {
+        weight = scratch.alloc<float>(mapsize);
+        if (weight == 0)
+            goto C2LAllocError;
+    }
 
-            if (focus[rho] >= 0) {
-                F0x = x0 - focus[rho] * sintable[theta];
-                F0y = y0 + focus[rho] * costable[theta];
-                F1x = x0 + focus[rho] * sintable[theta];
-                F1y = y0 - focus[rho] * costable[theta];
-                maxaxis = tangaxis[rho];
-            }
-            else {
-                F0x = x0 - focus[rho] * costable[theta];
-                F0y = y0 - focus[rho] * sintable[theta];
-                F1x = x0 + focus[rho] * costable[theta];
-                F1y = y0 + focus[rho] * sintable[theta];
-                maxaxis = radialaxis[rho];
+    for (theta = 0; theta < nang_; theta++) {
+        //
+        g.shape (rho, theta, x0, y0, F0x, F0y, F1x, F1y, maxaxis);
+
+        if (coverage_ == ANALYTIC) {
+            // the weights are the areas of the pixels covered by the receptive field.
+            makeEllipse (rf, x0, y0, g.focus[rho], g.sintable[theta], g.costable[theta], maxaxis);
+            int n = rasterizeEllipse (rf, width_, height_, coverageTolerance (rf), true, pixels, areas);
+            if (n == 0) {
+                // outside of the image, the closest pixel.
+                intx = (int) floor (x0 + width_ / 2);
+                inty = (int) floor (y0 + height_ / 2);
+                intx = (intx < 0) ? 0 : ((intx >= width_) ? width_ - 1 : intx);
+                inty = (inty < 0) ? 0 : ((inty >= height_) ? height_ - 1 : inty);
+                pixels[0] = inty * width_ + intx;
+                areas[0] = 1.0;
+                n = 1;
             }
 
-            if ((mode == RADIAL) || (mode == TANGENTIAL))
-                maxaxis = radii[rho];
+            double sum = 0.0;
+            for (j = 0; j < n; j++)
+                sum += areas[j];
+
+            for (j = 0; j < n; j++) {
+                table->position[j] = (pixels[j] / width_) * stride + 3 * (pixels[j] % width_);
+                table->iweight[j] = (int) (areas[j] / sum * 65536.0);
+            }
+            table->divisor = n;
+        }
+        else {
+            // the ring block is reused by each entry, clear all of it.
+            memset (table->position, 0, mapsize * sizeof(int));
+            memset (weight, 0, mapsize * sizeof(float));
 
             for (locX = (x0 - lim); locX <= (x0 + lim); locX += step)
                 for (locY = (y0 - lim); locY <= (y0 + lim); locY += step) {
@@ -467,7 +1640,7 @@ int logpolarTransform::RCbuildC2LMap (double scaleFact, int mode, int padding)
                                 j = 0;
                                 while ((j < mapsize) && (table->position[j] != 0)) {
                                     //
-                                    if (table->position[j] == (3 * (inty * (width_ + padding) + intx))) {
+                                    if (table->position[j] == inty * stride + 3 * intx) {
                                         weight[j]++;
                                         found = true;
                                         j = mapsize;
@@ -478,7 +1651,7 @@ int logpolarTransform::RCbuildC2LMap (double scaleFact, int mode, int padding)
                                 if (!found)
                                     for (j = 0; j < mapsize; j++) {
                                         if (table->position[j] == 0) {
-                                            table->position[j] = 3 * (inty * (width_ + padding) + intx);
+                                            table->position[j] = inty * stride + 3 * intx;
                                             weight[j]++;
                                             break;
                                         }
@@ -503,410 +1676,402 @@ int logpolarTransform::RCbuildC2LMap (double scaleFact, int mode, int padding)
                 weight[k] = weight[k] / sum;
                 table->iweight[k] = (int) (weight[k] * 65536.0);
             } 
+        }
 
-            if (theta != nang_-1 || rho != necc_-1) {
-                table[1].position = table->position + mapsize;
-                table[1].iweight = table->iweight + mapsize;
+        if (cov) {
+            // the pixels of the receptive field, for building the L2C table. The analytic ones
+            // are those the L2C build would rasterize: the pixels the receptive field touches,
+            // even for less than the tolerance, and none for a receptive field outside of the image.
+            if (coverage_ == ANALYTIC) {
+                const int n = rasterizeEllipse (rf, width_, height_, coverageTolerance (rf), false, pixels, 0);
+                cov->pixels.insert(cov->pixels.end(), pixels, pixels + n);
+            }
+            else
+            for (j = 0; j < table->divisor; j++) {
+                const int q = table->position[j];
+                cov->pixels.push_back((q / stride) * width_ + (q % stride) / 3);
             }
-            table++;
+            cov->offset[rho * nang_ + theta + 1] = (int)cov->pixels.size();
         }
 
-        delete[] weight;    // :(
+        if (theta != nang_-1) {
+            table[1].position = table->position + mapsize;
+            table[1].iweight = table->iweight + mapsize;
+        }
+        table++;
     }
 
-    // clean up temporaries.
-    if (tangaxis) delete[] tangaxis;
-    if (radialaxis) delete[] radialaxis;
-    if (focus) delete[] focus;
-    if (radii2) delete[] radii2;
-    if (currRad) delete[] currRad;
-    if (nextRad) delete[] nextRad;
-    if (sintable) delete[] sintable;
-    if (costable) delete[] costable;
+    scratch.rewind(mark);
     return 0;
 
 C2LAllocError:
-    // clean up temporaries.
-    if (tangaxis) delete[] tangaxis;
-    if (radialaxis) delete[] radialaxis;
-    if (focus) delete[] focus;
-    if (radii2) delete[] radii2;
-    if (currRad) delete[] currRad;
-    if (nextRad) delete[] nextRad;
-    if (sintable) delete[] sintable;
-    if (costable) delete[] costable;
+    // the entries of the ring are freed with the table, the scratch goes back to the arena.
+    scratch.rewind(mark);
     cerr << "logpolarTransform: memory allocation issue, no tables generated" << endl;
     return 2;
 }
 
-void logpolarTransform::RCgetLpImg (unsigned char *lpImg, unsigned char *cartImg, cart2LpPixel * Table, int padding)
+void logpolarTransform::RCgetLpImg (unsigned char *lpImg, unsigned char *cartImg, cart2LpPixel * Table, int padding, int firstRing, int lastRing)
 {
-    int r[3];
-    int t = 0;
-
-    unsigned char *img = lpImg;
-
-    for (int i = 0; i < necc_; i++, img+=padding) {
-        for (int j = 0; j < nang_; j++) {
-            r[0] = r[1] = r[2] = 0;
-            t = 0;
-
-            const int div = Table->divisor;
-            int *pos = Table->position;
-            int *w = Table->iweight;
-            for (int i = 0; i < div; i++, pos++, w++) {
-                int *d = r;
-                unsigned char *in = &cartImg[*pos];
-                *d++ += *in++ * *w;
-                *d++ += *in++ * *w;
-                *d += *in * *w;
-                t += *w;
-            }
+    kernels().getLpImg (lpImg, cartImg, Table, nang_, padding, firstRing, lastRing);
+}
+
+void logpolarTransform::RCremapSpan (unsigned char *img, unsigned char *lpImg, int entry, int n)
+{
+    kernels().remapSpan (img, lpImg, l2cTaps16, l2cTaps32, l2cOffset + entry, n);
+}
+
+void logpolarTransform::RCgetCartImg (unsigned char *cartImg, unsigned char *lpImg, int padding, int firstRow, int lastRow)
+{
+    kernels().getCartImg (cartImg, lpImg, l2cSpan, l2cRow, l2cTaps16, l2cTaps32, l2cOffset, width_, padding, firstRow, lastRow, clear_);
+}
 
-            *img++ = (unsigned char)(r[0] / t);
-            *img++ = (unsigned char)(r[1] / t);
-            *img++ = (unsigned char)(r[2] / t);
+void logpolarTransform::RCgetCartImgRoi (yarp::sig::ImageOf<yarp::sig::PixelRgb>& roi, unsigned char *lpImg, int x0, int y0)
+{
+    int k;
+    const int w = roi.width();
+    const int h = roi.height();
+
+    for (k = 0; k < h; k++) {
+        unsigned char *img = roi.getRow(k);
+        const int row = y0 + k;
+
+        // the columns of the rectangle covered by the logpolar image.
+        int first = x0;
+        int last = x0;
+        if (row >= 0 && row < height_) {
+            first = (x0 > l2cSpan[2*row]) ? x0 : l2cSpan[2*row];
+            last = (x0 + w < l2cSpan[2*row+1]) ? x0 + w : l2cSpan[2*row+1];
+        }
 
-            Table++;
+        if (first >= last) {
+            memset(img, 0, w * 3);
+            continue;
         }
+
+        memset(img, 0, (first - x0) * 3);
+        img += (first - x0) * 3;
+
+        RCremapSpan (img, lpImg, l2cRow[row] + first - l2cSpan[2*row], last - first);
+        img += (last - first) * 3;
+
+        memset(img, 0, (x0 + w - last) * 3);
     }
 }
 
-void logpolarTransform::RCgetCartImg (unsigned char *cartImg, unsigned char *lpImg, lp2CartPixel * Table, int padding)
+void logpolarTransform::RCgetCartImgFovea (yarp::sig::ImageOf<yarp::sig::PixelRgb>& cart, 
+                                            unsigned char *lpImg, 
+                                            const yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea,
+                                            const foveaBlendMask& mask,
+                                            int firstRow, int lastRow)
 {
-    int k, i, j;
-    int tempPixel[3];
-    unsigned char *img = cartImg;
-
-    for (k = 0; k < height_; k++, img += padding) {
-        for (j = 0; j < width_; j++) {
-            tempPixel[0] = 0;
-            tempPixel[1] = 0;
-            tempPixel[2] = 0;
-
-            if (Table->iweight != 0) {
-                for (i = 0; i < Table->iweight; i++) {
-                    int *d = tempPixel;
-                    unsigned char *lp = &lpImg[Table->position[i]];
-                    *d++ += *lp++;
-                    *d++ += *lp++;
-                    *d += *lp;
-                }
-
-                *img++ = tempPixel[0] / Table->iweight;
-                *img++ = tempPixel[1] / Table->iweight;
-                *img++ = tempPixel[2] / Table->iweight;
+    int k, fx, fy;
+
+    // the rows are remapped by the span kernel, then the fovea is blended into the rows crossing it.
+    RCgetCartImg (cart.getRawImage(), lpImg, cart.getPadding(), firstRow, lastRow);
+
+    // the part of the fovea within the image and the rows to convert.
+    const int fx0 = (mask.x0 < 0) ? -mask.x0 : 0;
+    const int fx1 = (mask.x0 + mask.size > width_) ? width_ - mask.x0 : mask.size;
+    const int fy0 = (firstRow - mask.y0 > 0) ? firstRow - mask.y0 : 0;
+    const int fy1 = (lastRow - mask.y0 < mask.size) ? lastRow - mask.y0 : mask.size;
+
+    for (fy = fy0; fy < fy1; fy++) {
+        k = mask.y0 + fy;
+        unsigned char *img = cart.getRow(k);
+        const int first = l2cSpan[2*k];
+        const int last = l2cSpan[2*k+1];
+        const unsigned char *frow = fovea.getRow(mask.ys[fy]);
+        const int *alpha = mask.alpha + fy * mask.size;
+
+        for (fx = fx0; fx < fx1; fx++) {
+            const int j = mask.x0 + fx;
+            const int a = alpha[fx];
+            const unsigned char *f = frow + mask.xs[fx];
+            unsigned char *p = img + 3 * j;
+
+            // the pixels not covered by the logpolar image are blended over black (they might 
+            // not be cleared).
+            if (j >= first && j < last) {
+                p[0] = (a * f[0] + (256 - a) * p[0]) >> 8;
+                p[1] = (a * f[1] + (256 - a) * p[1]) >> 8;
+                p[2] = (a * f[2] + (256 - a) * p[2]) >> 8;
             }
             else {
-                *img++ = 0;
-                *img++ = 0;
-                *img++ = 0;
+                p[0] = (a * f[0]) >> 8;
+                p[1] = (a * f[1]) >> 8;
+                p[2] = (a * f[2]) >> 8;
             }
-
-            Table++;
         }
     }
 }
 
 // inverse logpolar.
-int logpolarTransform::RCbuildL2CMap (double scaleFact, int hOffset, int vOffset, int mode, int padding)
+int logpolarTransform::RCbuildL2CMap (const rfGeometry& g, int hOffset, int vOffset, int padding, const rfCoverage *cov, buildArena& scratch)
 {
-    if (overlap_ <= -1.0) {
-        cerr << "logpolarTransform: overlap must be greater than -1" << endl;
-        return 1;
-    }
-
-	int cSize = width_;
-	
-	if (width_ > height_)
-		cSize = height_;
-
-    double angle = (2.0 * PI / nang_);   // Angular size of one pixel
-    double sinus = sin (angle / 2.0);
-    double tangent = sinus / cos (angle / 2.0);
-    int fov;                    // Number of rings in fovea
     int lim;
 
-    double lambda;              // Log Index
-    double firstRing;           // Diameter of the receptive fields in the first ring when overlap is 0
-    double *currRad;            // Distance of the center of the current ring RF's from the center of the mapping
-    double *nextRad;            // Distance of the center of the next ring's RF's from the center of the mapping
-    double r0;                  // lower limit of RF0 in the "pure" log polar mapping
-
     double x0, y0;              // Cartesian Coordinates
     double locX, locY, locRad;
-    double *radii;
-    double *tangaxis;
-    double *radialaxis;
-    double *focus;
-    double *radii2;
-    double A;
-    double L;
     int *partCtr;
     double step;
     double F0x, F0y, F1x, F1y;
     double maxaxis;
 
-    int rho, theta, j, memSize;
+    int rho, theta, j, memSize, covered;
+    int intx, inty;
     bool found;
     const double precision = 10.0;
 
-    // main table pointer (temporary).
-    lp2CartPixel *table = l2cTable;
+    // the table (temporary), allocated once the covered pixels are known and packed at the end.
+    // All the temporaries come from the arena and go back to it on return.
+    const buildArena::marker mark = scratch.mark();
+    lp2CartPixel *table = 0;
+    int *positions = 0;
+
+    // analytic coverage: the pixels of a receptive field.
+    int *pixels = 0;
+    rfEllipse rf;
 
     // temporary counter (per pixel).
-    partCtr = new int[width_ * height_];
+    partCtr = scratch.alloc<int>(width_ * height_);
     if (partCtr == 0)
         goto L2CAllocError;
 
     memset (partCtr, 0, width_ * height_ * sizeof (int));
 
-    lambda = (1.0 + sinus) / (1.0 - sinus);
-    fov = (int) (lambda / (lambda - 1));
-    firstRing = (1.0 / (lambda - 1)) - (int) (1.0 / (lambda - 1));
-    r0 = 1.0 / (pow (lambda, fov) * (lambda - 1));
-
-    tangaxis = new double[necc_];
-    radialaxis = new double[necc_];
-    focus = new double[necc_];
-    radii2 = new double[necc_];
-    currRad = new double[necc_];
-    nextRad = new double[necc_];
-
-    if ((tangaxis == 0) || (radialaxis == 0) || (focus == 0) || (radii2 == 0) || (currRad == 0) || (nextRad == 0))
-        goto L2CAllocError;
+    if (coverage_ == ANALYTIC && cov == 0) {
+        // buffers for the bounding box of the largest receptive field.
+        int maxLim = 0;
+        for (rho = 0; rho < necc_; rho++)
+            if (g.lim[rho] > maxLim)
+                maxLim = g.lim[rho];
 
-    /************************
-     * RF's size Computation *
-     ************************/
+        pixels = scratch.alloc<int>((2 * maxLim + 3) * (2 * maxLim + 3));
+        if (pixels == 0)
+            goto L2CAllocError;
+    }
 
-    for (rho = 0; rho < necc_; rho++) {
-        if (rho < fov)
-            if (rho == 0) {
-                currRad[rho] = firstRing * 0.5;
-                nextRad[rho] = firstRing;
-            }
-            else {
-                currRad[rho] = rho + firstRing - 0.5;
-                nextRad[rho] = currRad[rho] + 1.0;
+    memSize = 0;
+    if (cov) {
+        // the transpose of the coverage of the C2L table.
+        for (j = 0; j < (int)cov->pixels.size(); j++) {
+            inty = cov->pixels[j] / width_ + vOffset;
+            intx = cov->pixels[j] % width_ + hOffset;
+            if ((inty < height_) && (inty >= 0) && (intx < width_) && (intx >= 0)) {
+                partCtr[inty * width_ + intx]++;
+                memSize ++;
             }
-        else {
-            currRad[rho] = pow (lambda, rho) * (r0 + 0.5 / pow (lambda, fov));
-            nextRad[rho] = lambda * currRad[rho];
-        }
-        
-        tangaxis[rho] =
-            scaleFact * 2.0 * currRad[rho] * sinus * (overlap_ + 1.0) / (2.0);
-
-        radialaxis[rho] =
-            scaleFact * (nextRad[rho] - currRad[rho]) * (overlap_ + 1.0);
-
-        if (rho < fov)
-            radialaxis[rho] /= 2.0;
-        else
-            radialaxis[rho] /= (1.0 + lambda);
-
-        if ((rho < fov) && (mode == ELLIPTICAL))
-        {
-            A = radialaxis[rho] * radialaxis[rho];
-            L = scaleFact * currRad[rho] * (overlap_ + 1.0);
-            L = L * L;
-            tangaxis[rho] = tangent * sqrt (L - A);
         }
     }
+    else {
+        for (rho = 0; rho < necc_; rho++) {
+            //
+            lim = g.lim[rho];
+            step = lim / precision;
+            if (step > 1)
+                step = 1;
+
+            for (theta = 0; theta < nang_; theta++) {
+                //
+                g.shape (rho, theta, x0, y0, F0x, F0y, F1x, F1y, maxaxis);
+
+                if (coverage_ == ANALYTIC) {
+                    // the offsets shift the receptive field instead of the pixels.
+                    makeEllipse (rf, x0 + hOffset, y0 + vOffset, g.focus[rho], g.sintable[theta], g.costable[theta], maxaxis);
+                    const int n = rasterizeEllipse (rf, width_, height_, coverageTolerance (rf), false, pixels, 0);
+                    for (j = 0; j < n; j++)
+                        partCtr[pixels[j]]++;
+                    memSize += n;
+                    continue;
+                }
 
-    radialaxis[0] = 0.5 * scaleFact * (firstRing) * (overlap_ + 1.0);
-
-    if (mode == RADIAL)
-        radii = radialaxis;
-    else
-        radii = tangaxis;
-
-    for (rho = 0; rho < necc_; rho++) {
-        if (mode != ELLIPTICAL)
-            focus[rho] = 0;
-        else {
-            focus[rho] =
-                -sqrt (fabs (radialaxis[rho] * radialaxis[rho] -
-                             tangaxis[rho] * tangaxis[rho]));
+                for (locX = (x0 - lim); locX <= (x0 + lim); locX += step)
+                    for (locY = (y0 - lim); locY <= (y0 + lim); locY += step) {
+                        //
+                        intx = (int) (locX + width_ / 2);
+                        inty = (int) (locY + height_ / 2);
+
+                        locRad =
+                            sqrt ((locX - F0x) * (locX - F0x) +
+                                  (locY - F0y) * (locY - F0y));
+                        locRad +=
+                            sqrt ((locX - F1x) * (locX - F1x) +
+                                  (locY - F1y) * (locY - F1y));
+
+                        if (locRad < 2 * maxaxis)
+                            if ((inty + vOffset < height_) && (inty + vOffset >= 0))
+                                if ((intx + hOffset < width_)
+                                    && (intx + hOffset >= 0)) {
+                                    //
+                                    partCtr[(inty + vOffset) * width_ + intx + hOffset]++;
+                                    memSize ++;
+                                }
+                    }
+            }
         }
-        if (tangaxis[rho] >= radialaxis[rho])
-            focus[rho] = -focus[rho];
-
-        radii2[rho] = radii[rho] * radii[rho];
     }
-    
-    double *sintable;
-    double *costable;
-    int intx, inty;
 
-    sintable = new double[nang_];
-    costable = new double[nang_];
-    if ((sintable == 0) || (costable == 0))
+    // the span of the covered pixels of each row, only these have an entry in the table.
+    l2cSpan = new int[2 * height_];
+    l2cRow = new int[height_ + 1];
+    if (l2cSpan == 0 || l2cRow == 0)
         goto L2CAllocError;
-
-    for (j = 0; j < nang_; j++) {
-        sintable[j] = sin (angle * (j + 0.5));  // Angular positions of the centers of the RF's
-        costable[j] = cos (angle * (j + 0.5));
-    }
-
-    memSize = 0;
-    for (rho = 0; rho < necc_; rho++) {
-        //
-        if ((mode == RADIAL) || (mode == TANGENTIAL))
-            lim = (int) (radii[rho] + 1.5);
-        else
-            lim = (int) (__max64f (tangaxis[rho], radialaxis[rho]) + 1.5);
-
-        step = lim / precision;
-        if (step > 1)
-            step = 1;
-
-        for (theta = 0; theta < nang_; theta++) {
-            //
-            x0 = scaleFact * currRad[rho] * costable[theta];
-            y0 = scaleFact * currRad[rho] * sintable[theta];
-
-            if (focus[rho] >= 0) {
-                F0x = x0 - focus[rho] * sintable[theta];
-                F1x = x0 + focus[rho] * sintable[theta];
-                F0y = y0 + focus[rho] * costable[theta];
-                F1y = y0 - focus[rho] * costable[theta];
-                maxaxis = tangaxis[rho];
-            }
-            else {
-                F0x = x0 - focus[rho] * costable[theta];
-                F1x = x0 + focus[rho] * costable[theta];
-                F0y = y0 - focus[rho] * sintable[theta];
-                F1y = y0 + focus[rho] * sintable[theta];
-                maxaxis = radialaxis[rho];
+    covered = 0;
+    for (j = 0; j < height_; j++) {
+        int first = width_, last = 0;
+        for (int i = 0; i < width_; i++) {
+            if (partCtr[j * width_ + i] != 0) {
+                if (i < first) first = i;
+                last = i + 1;
             }
-            if ((mode == RADIAL) || (mode == TANGENTIAL))
-                maxaxis = radii[rho];
-
-            for (locX = (x0 - lim); locX <= (x0 + lim); locX += step)
-                for (locY = (y0 - lim); locY <= (y0 + lim); locY += step) {
-                    //
-                    intx = (int) (locX + width_ / 2);
-                    inty = (int) (locY + height_ / 2);
-
-                    locRad =
-                        sqrt ((locX - F0x) * (locX - F0x) +
-                              (locY - F0y) * (locY - F0y));
-                    locRad +=
-                        sqrt ((locX - F1x) * (locX - F1x) +
-                              (locY - F1y) * (locY - F1y));
-
-                    if (locRad < 2 * maxaxis)
-                        if ((inty + vOffset < height_) && (inty + vOffset >= 0))
-                            if ((intx + hOffset < width_)
-                                && (intx + hOffset >= 0)) {
-                                //
-                                partCtr[(inty + vOffset) * width_ + intx + hOffset]++;
-                                memSize ++;
-                            }
-                }
         }
+        if (first >= last)
+            first = last = 0;
+        l2cSpan[2*j] = first;
+        l2cSpan[2*j+1] = last;
+        l2cRow[j] = covered;
+        covered += last - first;
     }
+    l2cRow[height_] = covered;
 
-    table->position = new int[memSize]; // contiguous allocation.
-    if (table->position == 0)
+    table = scratch.alloc<lp2CartPixel>((covered > 0) ? covered : 1);
+    positions = scratch.alloc<int>((memSize > 0) ? memSize : 1); // contiguous allocation.
+    if (table == 0 || positions == 0)
         goto L2CAllocError;
-    memset(table->position, -1, sizeof(int) * memSize);
-    table->iweight = 0;
+    memset(positions, -1, sizeof(int) * memSize);
 
-    for (j = 1; j < width_ * height_; j++) {
-        table[j].position = table[j-1].position + partCtr[j-1];
-        table[j].iweight = 0;
+    {
+        int *pos = positions;
+        for (j = 0; j < height_; j++) {
+            for (int i = l2cSpan[2*j]; i < l2cSpan[2*j+1]; i++) {
+                table[l2cRow[j] + i - l2cSpan[2*j]].position = pos;
+                table[l2cRow[j] + i - l2cSpan[2*j]].iweight = 0;
+                pos += partCtr[j * width_ + i];
+            }
+        }
     }
 
-    for (rho = 0; rho < necc_; rho++) {
-        if ((mode == RADIAL) || (mode == TANGENTIAL))
-            lim = (int) (radii[rho] + 1.5);
-        else
-            lim = (int) (__max64f (tangaxis[rho], radialaxis[rho]) + 1.5);
-
-        step = lim / precision;
-
-        if (step > 1)
-            step = 1;
-
-        for (theta = 0; theta < nang_; theta++) {
-            //
-            x0 = scaleFact * currRad[rho] * costable[theta];
-            y0 = scaleFact * currRad[rho] * sintable[theta];
-
-            if (focus[rho] >= 0) {
-                F0x = x0 - focus[rho] * sintable[theta];
-                F0y = y0 + focus[rho] * costable[theta];
-                F1x = x0 + focus[rho] * sintable[theta];
-                F1y = y0 - focus[rho] * costable[theta];
-                maxaxis = tangaxis[rho];
-            }
-            else {
-                F0x = x0 - focus[rho] * costable[theta];
-                F0y = y0 - focus[rho] * sintable[theta];
-                F1x = x0 + focus[rho] * costable[theta];
-                F1y = y0 + focus[rho] * sintable[theta];
-                maxaxis = radialaxis[rho];
+    if (cov) {
+        // every receptive field covers a pixel once, in the same order as sampling them again.
+        for (rho = 0; rho < necc_; rho++) {
+            for (theta = 0; theta < nang_; theta++) {
+                const int k = rho * nang_ + theta;
+                for (j = cov->offset[k]; j < cov->offset[k + 1]; j++) {
+                    inty = cov->pixels[j] / width_ + vOffset;
+                    intx = cov->pixels[j] % width_ + hOffset;
+                    if ((inty < height_) && (inty >= 0) && (intx < width_) && (intx >= 0)) {
+                        lp2CartPixel *entry = &table[l2cRow[inty] + intx - l2cSpan[2*inty]];
+                        entry->position[entry->iweight] = 3 * k + (padding * rho);
+                        entry->iweight++;
+                    }
+                }
             }
-            if ((mode == RADIAL) || (mode == TANGENTIAL))
-                maxaxis = radii[rho];
-
-            for (locX = (x0 - lim); locX <= (x0 + lim); locX += step)
-                for (locY = (y0 - lim); locY <= (y0 + lim); locY += step) {
-                    intx = (int) (locX + width_ / 2);
-                    inty = (int) (locY + height_ / 2);
+        }
+    }
+    else {
+        for (rho = 0; rho < necc_; rho++) {
+            lim = g.lim[rho];
+            step = lim / precision;
+
+            if (step > 1)
+                step = 1;
+
+            for (theta = 0; theta < nang_; theta++) {
+                //
+                g.shape (rho, theta, x0, y0, F0x, F0y, F1x, F1y, maxaxis);
+
+                if (coverage_ == ANALYTIC) {
+                    // every receptive field covers a pixel once, no need to look for duplicates.
+                    makeEllipse (rf, x0 + hOffset, y0 + vOffset, g.focus[rho], g.sintable[theta], g.costable[theta], maxaxis);
+                    const int n = rasterizeEllipse (rf, width_, height_, coverageTolerance (rf), false, pixels, 0);
+                    for (j = 0; j < n; j++) {
+                        inty = pixels[j] / width_;
+                        intx = pixels[j] % width_;
+                        lp2CartPixel *entry = &table[l2cRow[inty] + intx - l2cSpan[2*inty]];
+                        entry->position[entry->iweight] = 3 * (rho * nang_ + theta) + (padding * rho);
+                        entry->iweight++;
+                    }
+                    continue;
+                }
 
-                    locRad =
-                        sqrt ((locX - F0x) * (locX - F0x) +
-                              (locY - F0y) * (locY - F0y));
-                    locRad +=
-                        sqrt ((locX - F1x) * (locX - F1x) +
-                              (locY - F1y) * (locY - F1y));
+                for (locX = (x0 - lim); locX <= (x0 + lim); locX += step)
+                    for (locY = (y0 - lim); locY <= (y0 + lim); locY += step) {
+                        intx = (int) (locX + width_ / 2);
+                        inty = (int) (locY + height_ / 2);
+
+                        locRad =
+                            sqrt ((locX - F0x) * (locX - F0x) +
+                                  (locY - F0y) * (locY - F0y));
+                        locRad +=
+                            sqrt ((locX - F1x) * (locX - F1x) +
+                                  (locY - F1y) * (locY - F1y));
+
+                        if (locRad < 2 * maxaxis)
+                            if ((inty + vOffset < height_) && (inty + vOffset >= 0))
+                                if ((intx + hOffset < width_) && (intx + hOffset >= 0)) {
+                                    found = false;
+                                    lp2CartPixel *entry = &table[l2cRow[inty + vOffset] + intx + hOffset - l2cSpan[2*(inty + vOffset)]];
 
-                    if (locRad < 2 * maxaxis)
-                        if ((inty + vOffset < height_) && (inty + vOffset >= 0))
-                            if ((intx + hOffset < width_) && (intx + hOffset >= 0)) {
-                                found = false;
+                                    for (j = 0; j < partCtr[(inty + vOffset) * width_ + intx + hOffset]; j++) {
+                                        if (entry->position[j] == 3 * (rho * nang_ + theta) + (padding * rho)) {
+                                            found = true;
+                                            break;
+                                        }
+                                    }
 
-                                for (j = 0; j < partCtr[(inty + vOffset) * width_ + intx + hOffset]; j++) {
-                                    if (table [(inty + vOffset) * width_ + intx + hOffset].position[j] == 3 * (rho * nang_ + theta) + (padding * rho)) {
-                                        found = true;
-                                        break;
+                                    if (!found) {
+                                        entry->position[entry->iweight] = 3 * (rho * nang_ + theta) + (padding * rho);
+                                        entry->iweight++;
                                     }
                                 }
+                    }
+            }
+        }
+    }
 
-                                if (!found) {
-                                    table[(inty + vOffset) * width_ + intx + hOffset].position[table [(inty + vOffset) * width_ + intx + hOffset].iweight] = 3 * (rho * nang_ + theta) + (padding * rho);
-                                    table[(inty + vOffset) * width_ + intx + hOffset].iweight++;
-                                }
-                            }
-                }
+    // pack the table: a prefix sum of the number of taps and the taps alone, 16 bit wide
+    // when the logpolar image is small enough (no pointers in the data read by the remap).
+    {
+        int e, i, maxTap = 0;
+        l2cOffset = new unsigned int[covered + 1];
+        if (l2cOffset == 0)
+            goto L2CAllocError;
+
+        l2cOffset[0] = 0;
+        for (e = 0; e < covered; e++) {
+            l2cOffset[e+1] = l2cOffset[e] + table[e].iweight;
+            for (i = 0; i < table[e].iweight; i++)
+                if (table[e].position[i] > maxTap)
+                    maxTap = table[e].position[i];
+        }
+
+        const unsigned int taps = l2cOffset[covered];
+        if (maxTap < 65536) {
+            l2cTaps16 = new unsigned short[(taps > 0) ? taps : 1];
+            if (l2cTaps16 == 0)
+                goto L2CAllocError;
+            for (e = 0; e < covered; e++)
+                for (i = 0; i < table[e].iweight; i++)
+                    l2cTaps16[l2cOffset[e] + i] = (unsigned short)table[e].position[i];
+        }
+        else {
+            l2cTaps32 = new unsigned int[(taps > 0) ? taps : 1];
+            if (l2cTaps32 == 0)
+                goto L2CAllocError;
+            for (e = 0; e < covered; e++)
+                for (i = 0; i < table[e].iweight; i++)
+                    l2cTaps32[l2cOffset[e] + i] = (unsigned int)table[e].position[i];
         }
     }
 
-    if (tangaxis) delete[] tangaxis;
-    if (radialaxis) delete[] radialaxis;
-    if (focus) delete[] focus;
-    if (radii2) delete[] radii2;
-    if (currRad) delete[] currRad;
-    if (nextRad) delete[] nextRad;
-    if (sintable) delete[] sintable;
-    if (costable) delete[] costable;
-    if (partCtr) delete [] partCtr;
+    scratch.rewind(mark);
     return 0;
 
 L2CAllocError:
-    if (tangaxis) delete[] tangaxis;
-    if (radialaxis) delete[] radialaxis;
-    if (focus) delete[] focus;
-    if (radii2) delete[] radii2;
-    if (currRad) delete[] currRad;
-    if (nextRad) delete[] nextRad;
-    if (sintable) delete[] sintable;
-    if (costable) delete[] costable;
-    if (partCtr) delete [] partCtr;
+    // the table built so far goes, the temporaries go back to the arena.
+    RCdeAllocateL2CTable ();
+    scratch.rewind(mark);
     cerr << "logpolarTransform: memory allocation issue, no tables generated" << endl;
     return 2;
 }
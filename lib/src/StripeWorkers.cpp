@@ -0,0 +1,96 @@
+/*
+ *  logpolar mapper library. a small pool of threads processing images by stripes.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program 
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be 
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A 
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file StripeWorkers.cpp 
+ * \brief Implementation of the pool of threads processing images by stripes.
+ */
+
+#include <iCub/logpolar/StripeWorkers.h>
+
+using namespace yarp::os;
+using namespace iCub::logpolar;
+
+/*
+ * a worker runs the same stripe of every job.
+ */
+class StripeWorkers::Worker : public Thread {
+private:
+    StripeWorkers *owner;
+    int index;
+    Semaphore go;
+
+public:
+    Worker(StripeWorkers *o, int i) : owner(o), index(i), go(0) {}
+
+    void startJob() { go.post(); }
+
+    void run() {
+        while (!isStopping()) {
+            go.wait();
+            if (isStopping())
+                break;
+
+            owner->job->processStripe(index, owner->stripes);
+            owner->done.post();
+        }
+    }
+
+    void onStop() { go.post(); }
+};
+
+StripeWorkers::StripeWorkers(int n) : done(0), mutex(1) {
+    nWorkers = (n > 1) ? n-1 : 0;
+    stripes = nWorkers + 1;
+    job = 0;
+    workers = 0;
+
+    if (nWorkers > 0) {
+        workers = new Worker *[nWorkers];
+        for (int i = 0; i < nWorkers; i++) {
+            // stripe 0 is processed by the calling thread.
+            workers[i] = new Worker(this, i+1);
+            workers[i]->start();
+        }
+    }
+}
+
+StripeWorkers::~StripeWorkers() {
+    for (int i = 0; i < nWorkers; i++) {
+        workers[i]->stop();
+        delete workers[i];
+    }
+    if (workers) delete[] workers;
+    workers = 0;
+    nWorkers = 0;
+}
+
+void StripeWorkers::run(StripeJob& j) {
+    mutex.wait();
+    job = &j;
+
+    for (int i = 0; i < nWorkers; i++)
+        workers[i]->startJob();
+
+    j.processStripe(0, stripes);
+
+    for (int i = 0; i < nWorkers; i++)
+        done.wait();
+
+    job = 0;
+    mutex.post();
+}
@@ -0,0 +1,49 @@
+/*
+ *  logpolar mapper library. the lookup tables compiled into the library.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarFixedTables.cpp
+ * \brief The registry of the lookup tables compiled into the library.
+ */
+
+#include <iCub/logpolar/logpolarTransformFixed.h>
+
+namespace iCub {
+    namespace logpolar {
+        // the tables generated by logpolarTableGenerator when the library is built
+        // with LOGPOLAR_FIXED_TABLES, none otherwise.
+        extern const logpolarFixedTables *const logpolarGeneratedTables;
+        extern const int logpolarGeneratedTablesCount;
+    }
+}
+
+using namespace iCub::logpolar;
+
+#ifndef LOGPOLAR_FIXED_TABLES
+const logpolarFixedTables *const iCub::logpolar::logpolarGeneratedTables = 0;
+const int iCub::logpolar::logpolarGeneratedTablesCount = 0;
+#endif
+
+const logpolarFixedTables *iCub::logpolar::findFixedTables(int necc, int nang, int w, int h, double overlap) {
+    //
+    for (int i = 0; i < logpolarGeneratedTablesCount; i++) {
+        const logpolarFixedTables *t = logpolarGeneratedTables + i;
+        if (t->necc == necc && t->nang == nang && t->width == w && t->height == h && t->overlap == overlap)
+            return t;
+    }
+    return 0;
+}
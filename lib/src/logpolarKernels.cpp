@@ -0,0 +1,81 @@
+/*
+ *  logpolar mapper library. the generic kernels and the choice of the kernels of the host.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarKernels.cpp
+ * \brief The generic kernels, built with the flags of the library, and the dispatcher.
+ * The other variants are compiled in when LOGPOLAR_KERNELS_<ISA> is defined.
+ */
+
+#define LP_KERNELS_TABLE kernelsGeneric
+#define LP_KERNELS_NAME "generic"
+#include "logpolarKernelsImpl.h"
+
+#include <cstdlib>
+
+#if defined(LOGPOLAR_KERNELS_NEON) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static const logpolarKernels *pickKernels ()
+{
+    // the variants the host supports, from the best.
+    const logpolarKernels *candidates[5];
+    int n = 0;
+
+#if defined(LOGPOLAR_KERNELS_AVX512) || defined(LOGPOLAR_KERNELS_AVX2) || defined(LOGPOLAR_KERNELS_SSE2)
+    // might run before the constructor of the runtime which detects the cpu.
+    __builtin_cpu_init ();
+#endif
+#ifdef LOGPOLAR_KERNELS_AVX512
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512bw"))
+        candidates[n++] = &kernelsAVX512;
+#endif
+#ifdef LOGPOLAR_KERNELS_AVX2
+    if (__builtin_cpu_supports ("avx2"))
+        candidates[n++] = &kernelsAVX2;
+#endif
+#ifdef LOGPOLAR_KERNELS_SSE2
+    if (__builtin_cpu_supports ("sse2"))
+        candidates[n++] = &kernelsSSE2;
+#endif
+#if defined(LOGPOLAR_KERNELS_NEON) && defined(__linux__)
+    if (getauxval (AT_HWCAP) & HWCAP_NEON)
+        candidates[n++] = &kernelsNEON;
+#endif
+    candidates[n++] = &kernelsGeneric;
+
+    // LOGPOLAR_KERNELS forces one of the supported variants, e.g. to compare them.
+    const char *forced = getenv ("LOGPOLAR_KERNELS");
+    if (forced != 0) {
+        for (int i = 0; i < n; i++)
+            if (strcmp (candidates[i]->name, forced) == 0)
+                return candidates[i];
+    }
+    return candidates[0];
+}
+
+// picked when the library is loaded, or by the first conversion if it comes earlier.
+static const logpolarKernels *selected = pickKernels ();
+
+const logpolarKernels& iCub::logpolar::kernels ()
+{
+    if (selected == 0)
+        selected = pickKernels ();
+    return *selected;
+}
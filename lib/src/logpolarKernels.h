@@ -0,0 +1,70 @@
+/*
+ *  logpolar mapper library. the hot loops of the conversions, built for several instruction sets.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarKernels.h
+ * \brief The kernels of the conversions (internal to the library). The same source,
+ * logpolarKernelsImpl.h, is compiled once per instruction set and the best variant
+ * the host supports is picked when the library is loaded.
+ */
+
+#ifndef __ICUB_LOGPOLAR_KERNELS_H__
+#define __ICUB_LOGPOLAR_KERNELS_H__
+
+#include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+
+namespace iCub {
+    namespace logpolar {
+        /**
+         * the kernels of one instruction set.
+         */
+        struct logpolarKernels
+        {
+            const char *name;   // the instruction set, as reported by kernelInstructionSet().
+
+            // the rings firstRing to lastRing (excluded) of a logpolar image, see logpolarTransform::RCgetLpImg.
+            void (*getLpImg) (unsigned char *lpImg, const unsigned char *cartImg, const cart2LpPixel *table,
+                              int nang, int padding, int firstRing, int lastRing);
+
+            // a run of n covered pixels of a cartesian image, from the packed L2C table (taps16 or taps32).
+            void (*remapSpan) (unsigned char *img, const unsigned char *lpImg, const unsigned short *taps16,
+                               const unsigned int *taps32, const unsigned int *offset, int n);
+
+            // the rows firstRow to lastRow (excluded) of a cartesian image, see logpolarTransform::RCgetCartImg.
+            void (*getCartImg) (unsigned char *cartImg, const unsigned char *lpImg, const int *span, const int *row,
+                                const unsigned short *taps16, const unsigned int *taps32, const unsigned int *offset,
+                                int width, int padding, int firstRow, int lastRow, bool clear);
+
+            // rows of bytes between two images of different strides.
+            void (*copyRows) (unsigned char *dst, int dstStride, const unsigned char *src, int srcStride, int bytes, int rows);
+        };
+
+        // the variants built (see lib/CMakeLists.txt), the generic one always is.
+        extern const logpolarKernels kernelsGeneric;
+        extern const logpolarKernels kernelsSSE2;
+        extern const logpolarKernels kernelsAVX2;
+        extern const logpolarKernels kernelsAVX512;
+        extern const logpolarKernels kernelsNEON;
+
+        /**
+         * the kernels of the host, picked once.
+         */
+        const logpolarKernels& kernels();
+    }
+}
+
+#endif
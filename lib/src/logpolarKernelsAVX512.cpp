@@ -0,0 +1,25 @@
+/*
+ *  logpolar mapper library. the kernels built for AVX512.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarKernelsAVX512.cpp
+ * \brief The kernels compiled with the AVX512 flags (see lib/CMakeLists.txt).
+ */
+
+#define LP_KERNELS_TABLE kernelsAVX512
+#define LP_KERNELS_NAME "avx512"
+#include "logpolarKernelsImpl.h"
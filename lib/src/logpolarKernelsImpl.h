@@ -0,0 +1,205 @@
+/*
+ *  logpolar mapper library. the hot loops of the conversions, built for several instruction sets.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarKernelsImpl.h
+ * \brief The kernels of the conversions, included once by each logpolarKernels*.cpp
+ * with LP_KERNELS_TABLE and LP_KERNELS_NAME defined. Each inclusion is compiled with
+ * the flags of its instruction set, thus the kernels live in an unnamed namespace and
+ * mustn't call inline functions of other headers (the linker might pick the copy built
+ * for another instruction set).
+ */
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "logpolarKernels.h"
+
+using namespace iCub::logpolar;
+
+namespace {
+
+// the weighted sum of the pixels of a receptive field, r receives the channels and the
+// return value is the sum of the weights.
+inline int sumTaps (int *r, const unsigned char *cartImg, const int *pos, const int *w, int div)
+{
+    int t = 0;
+    int k = 0;
+    r[0] = r[1] = r[2] = 0;
+
+#if defined(__AVX2__)
+    // the taps a vector at a time: each lane gathers the 4 bytes ending with the last
+    // channel of its pixel (the byte before the pixel isn't used, and isn't read past the
+    // image), a pixel at the very start of the image leaves the rest to the scalar loop.
+    const unsigned char *base = cartImg - 1;
+#if defined(__AVX512F__)
+    // 16 taps at a time, the remainder goes 8 at a time.
+    const __m512i zero16 = _mm512_setzero_si512();
+    const __m512i mask16 = _mm512_set1_epi32(0xff);
+    __m512i sr16 = zero16, sg16 = zero16, sb16 = zero16, st16 = zero16;
+    for (; k + 16 <= div; k += 16) {
+        const __m512i p = _mm512_loadu_si512((const void *)(pos + k));
+        if (_mm512_cmpeq_epi32_mask(p, zero16) != 0)
+            break;
+        const __m512i px = _mm512_i32gather_epi32(p, (const void *)base, 1);
+        const __m512i wt = _mm512_loadu_si512((const void *)(w + k));
+        sr16 = _mm512_add_epi32(sr16, _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(px, 8), mask16), wt));
+        sg16 = _mm512_add_epi32(sg16, _mm512_mullo_epi32(_mm512_and_si512(_mm512_srli_epi32(px, 16), mask16), wt));
+        sb16 = _mm512_add_epi32(sb16, _mm512_mullo_epi32(_mm512_srli_epi32(px, 24), wt));
+        st16 = _mm512_add_epi32(st16, wt);
+    }
+    r[0] = _mm512_reduce_add_epi32(sr16);
+    r[1] = _mm512_reduce_add_epi32(sg16);
+    r[2] = _mm512_reduce_add_epi32(sb16);
+    t = _mm512_reduce_add_epi32(st16);
+#endif
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    __m256i sr = zero, sg = zero, sb = zero, st = zero;
+    for (; k + 8 <= div; k += 8) {
+        const __m256i p = _mm256_loadu_si256((const __m256i *)(pos + k));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(p, zero)) != 0)
+            break;
+        const __m256i px = _mm256_i32gather_epi32((const int *)base, p, 1);
+        const __m256i wt = _mm256_loadu_si256((const __m256i *)(w + k));
+        sr = _mm256_add_epi32(sr, _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask), wt));
+        sg = _mm256_add_epi32(sg, _mm256_mullo_epi32(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask), wt));
+        sb = _mm256_add_epi32(sb, _mm256_mullo_epi32(_mm256_srli_epi32(px, 24), wt));
+        st = _mm256_add_epi32(st, wt);
+    }
+    int lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_hadd_epi32(_mm256_hadd_epi32(sr, sg), _mm256_hadd_epi32(sb, st)));
+    r[0] += lanes[0] + lanes[4];
+    r[1] += lanes[1] + lanes[5];
+    r[2] += lanes[2] + lanes[6];
+    t += lanes[3] + lanes[7];
+#endif
+
+    for (; k < div; k++) {
+        const unsigned char *in = &cartImg[pos[k]];
+        r[0] += in[0] * w[k];
+        r[1] += in[1] * w[k];
+        r[2] += in[2] * w[k];
+        t += w[k];
+    }
+    return t;
+}
+
+void getLpImg (unsigned char *lpImg, const unsigned char *cartImg, const cart2LpPixel *Table,
+               int nang, int padding, int firstRing, int lastRing)
+{
+    int r[3];
+
+    unsigned char *img = lpImg + firstRing * (nang * 3 + padding);
+    Table += firstRing * nang;
+
+    for (int i = firstRing; i < lastRing; i++, img+=padding) {
+        for (int j = 0; j < nang; j++) {
+            const int t = sumTaps (r, cartImg, Table->position, Table->iweight, Table->divisor);
+
+            *img++ = (unsigned char)(r[0] / t);
+            *img++ = (unsigned char)(r[1] / t);
+            *img++ = (unsigned char)(r[2] / t);
+
+            Table++;
+        }
+    }
+}
+
+// the packed L2C table: the taps of the covered pixel e are taps[offset[e]] up to
+// taps[offset[e+1]] (excluded), offsets of the logpolar image in bytes.
+template <class T>
+void remapTaps (unsigned char *img, const unsigned char *lpImg, const T *taps, const unsigned int *offset, int n)
+{
+    for (int j = 0; j < n; j++) {
+        const unsigned int first = offset[j];
+        const unsigned int last = offset[j+1];
+        if (first == last) {
+            *img++ = 0;
+            *img++ = 0;
+            *img++ = 0;
+            continue;
+        }
+
+        int r = 0, g = 0, b = 0;
+        for (unsigned int i = first; i < last; i++) {
+            const unsigned char *lp = lpImg + taps[i];
+            r += lp[0];
+            g += lp[1];
+            b += lp[2];
+        }
+
+        const int w = (int)(last - first);
+        *img++ = r / w;
+        *img++ = g / w;
+        *img++ = b / w;
+    }
+}
+
+void remapSpan (unsigned char *img, const unsigned char *lpImg, const unsigned short *taps16,
+                const unsigned int *taps32, const unsigned int *offset, int n)
+{
+    if (taps16)
+        remapTaps (img, lpImg, taps16, offset, n);
+    else
+        remapTaps (img, lpImg, taps32, offset, n);
+}
+
+void getCartImg (unsigned char *cartImg, const unsigned char *lpImg, const int *span, const int *row,
+                 const unsigned short *taps16, const unsigned int *taps32, const unsigned int *offset,
+                 int width, int padding, int firstRow, int lastRow, bool clear)
+{
+    int k;
+    const int stride = width * 3 + padding;
+
+    for (k = firstRow; k < lastRow; k++) {
+        // only the span of covered pixels has entries in the table, the rest is bulk cleared.
+        const int first = span[2*k];
+        const int last = span[2*k+1];
+        unsigned char *img = cartImg + k * stride;
+
+        if (clear) memset(img, 0, first * 3);
+        img += first * 3;
+
+        remapSpan (img, lpImg, taps16, taps32, offset + row[k], last - first);
+        img += (last - first) * 3;
+
+        if (clear) memset(img, 0, (width - last) * 3);
+    }
+}
+
+void copyRows (unsigned char *dst, int dstStride, const unsigned char *src, int srcStride, int bytes, int rows)
+{
+    for (int i = 0; i < rows; i++) {
+        memcpy(dst, src, bytes);
+        dst += dstStride;
+        src += srcStride;
+    }
+}
+
+}
+
+const logpolarKernels iCub::logpolar::LP_KERNELS_TABLE = {
+    LP_KERNELS_NAME,
+    getLpImg,
+    remapSpan,
+    getCartImg,
+    copyRows
+};
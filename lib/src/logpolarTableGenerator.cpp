@@ -0,0 +1,126 @@
+/*
+ *  logpolar mapper library. generates the source of the lookup tables compiled into the library.
+ *
+ *  Copyright (C) 2026 The iCub contributors
+ *  Authors: see the history of this file in the repository
+ *
+ *  Permission is granted to copy, distribute, and/or modify this program
+ *  under the terms of the GNU General Public License, version 2 or any later
+ *  version published by the Free Software Foundation. A copy of the license can be
+ *  found at http://www.robotcub.org/icub/license/gpl.txt
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *  PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ */
+
+/**
+ * \file logpolarTableGenerator.cpp
+ * \brief A build tool writing the lookup tables of some geometries as read-only arrays,
+ * compiled into the library with the LOGPOLAR_FIXED_TABLES option.
+ *
+ * usage: logpolarTableGenerator output.cpp NECCxNANGxWxH [NECCxNANGxWxH ...]
+ */
+
+#include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+
+#include <cstdio>
+#include <vector>
+#include <string>
+
+using namespace std;
+using namespace iCub::logpolar;
+
+struct geometry {
+    int necc, nang, w, h;
+    string name;
+};
+
+template <class T>
+static void writeArray (FILE *out, const char *type, const char *array, const string& name, const vector<T>& v)
+{
+    fprintf (out, "static const %s %s_%s[] = {", type, array, name.c_str());
+    // an empty array isn't valid C++, a single zero is never read.
+    if (v.size() == 0)
+        fprintf (out, " 0 ");
+    for (size_t i = 0; i < v.size(); i++) {
+        if (i % 16 == 0)
+            fprintf (out, "\n    ");
+        fprintf (out, "%ld,", (long)v[i]);
+    }
+    fprintf (out, "\n};\n\n");
+}
+
+int main (int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf (stderr, "usage: %s output.cpp NECCxNANGxWxH [NECCxNANGxWxH ...]\n", argv[0]);
+        return 1;
+    }
+
+    vector<geometry> geometries;
+    for (int i = 2; i < argc; i++) {
+        geometry g;
+        if (sscanf (argv[i], "%dx%dx%dx%d", &g.necc, &g.nang, &g.w, &g.h) != 4 ||
+            g.necc <= 0 || g.nang <= 0 || g.w <= 0 || g.h <= 0) {
+            fprintf (stderr, "logpolarTableGenerator: wrong geometry %s\n", argv[i]);
+            return 1;
+        }
+        char name[64];
+        sprintf (name, "%d_%d_%d_%d", g.necc, g.nang, g.w, g.h);
+        g.name = name;
+        geometries.push_back (g);
+    }
+
+    FILE *out = fopen (argv[1], "w");
+    if (out == 0) {
+        fprintf (stderr, "logpolarTableGenerator: can't write %s\n", argv[1]);
+        return 1;
+    }
+
+    fprintf (out, "// generated by logpolarTableGenerator, do not edit.\n\n");
+    fprintf (out, "#include <iCub/logpolar/logpolarTransformFixed.h>\n\n");
+    fprintf (out, "namespace iCub {\n    namespace logpolar {\n");
+    fprintf (out, "        extern const logpolarFixedTables *const logpolarGeneratedTables;\n");
+    fprintf (out, "        extern const int logpolarGeneratedTablesCount;\n");
+    fprintf (out, "    }\n}\n\n");
+
+    for (size_t k = 0; k < geometries.size(); k++) {
+        const geometry& g = geometries[k];
+        logpolarTransform trsf;
+        logpolarPackedTables t;
+        if (!trsf.allocLookupTables (BOTH, g.necc, g.nang, g.w, g.h, 1.) || !trsf.packLookupTables (t)) {
+            fprintf (stderr, "logpolarTableGenerator: can't build the tables of %s\n", g.name.c_str());
+            fclose (out);
+            remove (argv[1]);
+            return 1;
+        }
+
+        writeArray (out, "unsigned int", "c2lOffset", g.name, t.c2lOffset);
+        writeArray (out, "int", "c2lPosition", g.name, t.c2lPosition);
+        writeArray (out, "int", "c2lWeight", g.name, t.c2lWeight);
+        writeArray (out, "int", "l2cSpan", g.name, t.l2cSpan);
+        writeArray (out, "int", "l2cRow", g.name, t.l2cRow);
+        writeArray (out, "unsigned int", "l2cOffset", g.name, t.l2cOffset);
+        writeArray (out, "unsigned int", "l2cTaps", g.name, t.l2cTaps);
+    }
+
+    fprintf (out, "static const iCub::logpolar::logpolarFixedTables tables[] = {\n");
+    for (size_t k = 0; k < geometries.size(); k++) {
+        const char *n = geometries[k].name.c_str();
+        fprintf (out, "    { %d, %d, %d, %d, 1.0,\n", geometries[k].necc, geometries[k].nang, geometries[k].w, geometries[k].h);
+        fprintf (out, "      c2lOffset_%s, c2lPosition_%s, c2lWeight_%s,\n", n, n, n);
+        fprintf (out, "      l2cSpan_%s, l2cRow_%s, l2cOffset_%s, l2cTaps_%s },\n", n, n, n, n);
+    }
+    fprintf (out, "};\n\n");
+    fprintf (out, "const iCub::logpolar::logpolarFixedTables *const iCub::logpolar::logpolarGeneratedTables = tables;\n");
+    fprintf (out, "const int iCub::logpolar::logpolarGeneratedTablesCount = %d;\n", (int)geometries.size());
+
+    if (fclose (out) != 0) {
+        fprintf (stderr, "logpolarTableGenerator: can't write %s\n", argv[1]);
+        remove (argv[1]);
+        return 1;
+    }
+    return 0;
+}
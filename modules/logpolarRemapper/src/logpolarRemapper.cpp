@@ -18,7 +18,8 @@
 \defgroup icub_logpolarRemapper logpolarRemapper
 
 This is a simple module that connects to the logpolar grabber (ServerLogpolarGrabber) and reconstruct 
-the logpolar image to cartesian.
+the logpolar image to cartesian. The full resolution fovea is blended into the centre of the 
+reconstruction, in the same pass.
 
 \section intro_sec Description
 This is a test and simple module that connects to a ServerLogpolarGrabber, reads
@@ -30,12 +31,24 @@ the remote interfaces).
 \section lib_sec Libraries
 The logpolarRemapper depends on the logPolar library.
 
+When the client driver supports it (ILogpolarImageBorrow), the logpolar images are remapped straight 
+from the receive buffer of the port, without copying them. When it also provides the cartesian 
+reconstruction (ILogpolarReconstruction), the remapping is left to the driver which caches the 
+tables and splits the work among its threads.
+
 \section parameters_sec Parameters
 \code
  --width: the width of the reconstructed image. This need not be the original image size.
  --height: the height of the reconstructed image.
+ --sizes: a list of sizes of the reconstructed images, either (w h) or a single value for a square
+   image, e.g. (240 480 960). Each size has its own output port, all are remapped from the same frame.
+ --threads: the number of threads remapping the images (default one per size).
  --name: the name of the module. This is used to create port names (e.g. /name:rpc, /name:out).
  --remote: the name of the remote grabber ports to connect to (e.g. /grabber).
+ --blend: the width in pixels of the border fading the fovea into the reconstruction (default 8).
+ --no_fovea: if present, reconstruct from the logpolar image only.
+ --bundle: if present, read the logpolar image and the fovea of the same frame from the combined 
+   stream of the grabber (the grabber must be started with --bundle).
 \endcode
 
 \section portsa_sec Ports Accessed
@@ -43,17 +56,21 @@ If the remote grabber base name is "grabber" then logpolarRemapper connects to:
  - /grabber
  - /grabber/logpolar
  - /grabber/fovea
+ - /grabber/bundle (with --bundle)
 
 \section portsc_sec Ports Created
 Input ports names are constructed from the "name" parameter, assuming this is set to "remapper", they are:
  - /remapper: stream of incoming cartesian images (not used by the current implementation).
  - /remapper/logpolar: stream of incoming logpolar images.
- - /remapper/fovea: stream of incoming foveal images (not used by the current implementation).
+ - /remapper/fovea: stream of incoming foveal images, blended into the reconstruction.
+ - /remapper/bundle: stream of incoming logpolar and foveal images (with --bundle).
  - /remapper:rpc: the module port which receives the rpc module messages (e.g. quit).
     - [quit]: quit the module (exit).
 
 Output ports names are also constructed from the "name" parameter, assuming this is set to "remapper", they are:
  - /remapper:out: stream of reconstructed images of size "width" and "height" (module parameters).
+ - /remapper/WxH:out: stream of reconstructed images of size W by H, one port for each of the "sizes"
+   (replaces /remapper:out).
 
 \section in_files_sec Input Data Files
 No input data files.
@@ -70,6 +87,8 @@ Linux and Windows.
 \section example_sec Example Instantiation of the Module
 logpolarRemapper --name remapper --remote /grabber --width 480
 
+logpolarRemapper --name remapper --remote /grabber --sizes "(240 480 (640 480))"
+
 \author Giorgio Metta
 
 Copyright (C) 2008 RobotCub Consortium
@@ -96,6 +115,7 @@ This file can be edited at src/logpolarRemapper/logpolarRemapper.cpp.
 
 #include <iCub/logpolar/LogpolarInterfaces.h>
 #include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+#include <iCub/logpolar/StripeWorkers.h>
 
 using namespace std;
 using namespace yarp::os;
@@ -106,13 +126,71 @@ using namespace iCub::logpolar;
 // the default app name (to be used in port names, etc.).
 ConstString defaultname("remapper");
 const int defaultSize = 480;
+const int defaultBlend = 8;
+
+/*
+ * an output of the remapper: the reconstruction at a given size with its own tables, 
+ * fovea blend and port.
+ */
+struct RemapOutput {
+    int width;
+    int height;
+    string name;
+    logpolarTransform trsf;
+    foveaBlendMask mask;
+    bool fusion;
+    Port out;
+    PortWriterBuffer<ImageOf<PixelRgb> > writer;
+    ImageOf<PixelRgb> *datum;
+
+    RemapOutput() : width(0), height(0), fusion(false), datum(0) {}
+};
+
+/*
+ * the remap of a frame to all the outputs. The rows of all the outputs are split in 
+ * stripes, thus large and small outputs are processed concurrently by all the threads.
+ */
+class RemapJob : public StripeJob {
+public:
+    RemapOutput *outputs;
+    int nOutputs;
+    int rows;
+    const ImageOf<PixelRgb> *lp;
+    const ImageOf<PixelRgb> *fovea;
+
+    RemapJob(RemapOutput *o, int n) : outputs(o), nOutputs(n), lp(0), fovea(0) {
+        rows = 0;
+        for (int i = 0; i < n; i++)
+            rows += o[i].height;
+    }
+
+    virtual void processStripe(int stripe, int stripes) {
+        int first, last;
+        getStripe(rows, stripe, stripes, first, last);
+
+        int base = 0;
+        for (int i = 0; i < nOutputs && base < last; base += outputs[i].height, i++) {
+            RemapOutput& o = outputs[i];
+            const int a = (first > base) ? first - base : 0;
+            const int b = (last < base + o.height) ? last - base : o.height;
+            if (a >= b)
+                continue;
+
+            // the fovea is skipped if it doesn't fit its blend.
+            if (o.fusion && fovea != 0 && fovea->width() == o.mask.fovea && fovea->height() == o.mask.fovea)
+                o.trsf.logpolarToCart(*o.datum, *lp, *fovea, o.mask, a, b);
+            else
+                o.trsf.logpolarToCart(*o.datum, *lp, a, b);
+        }
+    }
+};
 
 /*
  * my working thread.
  * this thread:
  * -starts the device drivers
  * -reads from the port, get images and remap them to cartesian (using the client grabber)
- * -writes to an output port the remapped images
+ * -writes to the output ports the remapped images, one port per size
  */
 class Remapper : public Thread {
 protected:
@@ -120,26 +198,77 @@ protected:
     string remote;
     string local;
     string carrier;
-    string outname;
     ILogpolarFrameGrabberImage *lpImage;
+    ILogpolarImageBorrow *lpBorrow;
+    ILogpolarReconstruction *lpRecon;
+    ILogpolarBundle *lpBundle;
     ImageOf<PixelRgb> lp;
+    ImageOf<PixelRgb> fovea;
+    bool fusion;
+    bool bundle;
+    int blend;
     bool active;
-    int width;
-    int height;
-    Port out;
-    PortWriterBuffer<ImageOf<PixelRgb> > writer;
-    logpolarTransform trsf;
+    RemapOutput *outputs;
+    int nOutputs;
+    int nThreads;
+    StripeWorkers *workers;
+
+    /*
+     * add an output of a given size.
+     */
+    void addOutput(const string& prefix, int w, int h, bool named) {
+        if (w == 0 && h == 0) {
+            w = h = defaultSize;
+        }
+        else
+        if (w == 0 && h != 0) {
+            w = h;
+        }
+        else 
+        if (h == 0 && w != 0) {
+            h = w;
+        }
+
+        RemapOutput& o = outputs[nOutputs++];
+        o.width = w;
+        o.height = h;
+        o.name = prefix;
+        if (named) {
+            char tmp[64];
+            sprintf(tmp, "/%dx%d", w, h);
+            o.name += tmp;
+        }
+        o.name += ":out";
+        o.writer.attach(o.out);
+    }
 
 public:
     /*
      * Constructor.
      */
     Remapper() {
+        lpImage = 0;
+        lpBorrow = 0;
+        lpRecon = 0;
+        lpBundle = 0;
         active = false;
-        width = height = defaultSize;
+        fusion = true;
+        bundle = false;
+        blend = defaultBlend;
+        outputs = 0;
+        nOutputs = 0;
+        nThreads = 1;
+        workers = 0;
     }
 
-    virtual ~Remapper() {}
+    virtual ~Remapper() {
+        if (workers) delete workers;
+        if (outputs) {
+            for (int i = 0; i < nOutputs; i++)
+                freeFoveaBlendMask(outputs[i].mask);
+            delete[] outputs;
+        }
+    }
 
     /*
      * configure the thread from the finder parameters.
@@ -155,26 +284,33 @@ public:
         local += ((name != "") ? name : defaultname);
 
         carrier = ((ResourceFinder&)rf).find("stream").asString();
-        outname = "/";
-        outname += ((name != "") ? name : defaultname);
-        outname += ":out";
-
-        width = ((ResourceFinder&)rf).find("width").asInt();
-        height = ((ResourceFinder&)rf).find("height").asInt();
 
-        if (width == 0 && height == 0) {
-            width = height = defaultSize;
-        }
-        else
-        if (width == 0 && height != 0) {
-            width = height;
+        // either a list of sizes, one port each, or the single width and height.
+        Bottle *sizes = ((ResourceFinder&)rf).find("sizes").asList();
+        if (sizes != 0 && sizes->size() > 0) {
+            outputs = new RemapOutput[sizes->size()];
+            for (int i = 0; i < sizes->size(); i++) {
+                // an entry is either (w h) or a single value for a square image.
+                Bottle *wh = sizes->get(i).asList();
+                if (wh != 0)
+                    addOutput(local, wh->get(0).asInt(), wh->get(1).asInt(), true);
+                else
+                    addOutput(local, sizes->get(i).asInt(), sizes->get(i).asInt(), true);
+            }
         }
-        else 
-        if (height == 0 && width != 0) {
-            height = width;
+        else {
+            outputs = new RemapOutput[1];
+            addOutput(local,
+                      ((ResourceFinder&)rf).find("width").asInt(),
+                      ((ResourceFinder&)rf).find("height").asInt(),
+                      false);
         }
 
-        writer.attach(out);
+        fusion = !((ResourceFinder&)rf).check("no_fovea");
+        bundle = ((ResourceFinder&)rf).check("bundle");
+        blend = ((ResourceFinder&)rf).check("blend", Value(defaultBlend)).asInt();
+        nThreads = ((ResourceFinder&)rf).check("threads", Value(nOutputs)).asInt();
+
         return true;
     }
 
@@ -187,16 +323,34 @@ public:
         p.put("device", "logpolarclient");
         p.put("local", local.c_str());
         p.put("remote", remote.c_str());
+        if (bundle)
+            p.put("bundle", 1);
         poly.open(p);
         if (poly.isValid()) {
             poly.view(lpImage);
+            poly.view(lpBorrow);
+            poly.view(lpRecon);
+            if (bundle)
+                poly.view(lpBundle);
             active = false;
 
             if (lpImage != 0) {
-                const int nang = lpImage->nang();
-                const int necc = lpImage->necc();
-                const int fovea = lpImage->fovea();
-                const double overlap = lpImage->overlap();
+                // the whole geometry in one go when available.
+                ILogpolarGeometry *lpGeometry = 0;
+                poly.view(lpGeometry);
+
+                LogpolarGeometry g;
+                if (lpGeometry == 0 || !lpGeometry->getGeometry(g)) {
+                    g.nang = lpImage->nang();
+                    g.necc = lpImage->necc();
+                    g.fovea = lpImage->fovea();
+                    g.overlap = lpImage->overlap();
+                }
+
+                const int nang = g.nang;
+                const int necc = g.necc;
+                const int fovea = g.fovea;
+                const double overlap = g.overlap;
 
                 if (necc != 0 && nang != 0) {
                     fprintf(stdout, "logpolar format with ang: %d ecc: %d fov: %d ovl: %f\n",
@@ -205,14 +359,38 @@ public:
                         fovea,
                         overlap);
 
-                    fprintf(stdout, "cartesian image of size %d %d\n", width, height);
-                    trsf.allocLookupTables(L2C, necc, nang, width, height, overlap);
+                    if (fusion && (g.width <= 0 || g.height <= 0 || fovea <= 0)) {
+                        fprintf(stderr, "the size of the sampled image is unknown, the fovea won't be blended\n");
+                        fusion = false;
+                    }
+
+                    // a single plain output is left to the driver, if it can.
+                    const bool driver = (lpRecon != 0 && !fusion && nOutputs == 1);
+
+                    for (int i = 0; i < nOutputs; i++) {
+                        RemapOutput& o = outputs[i];
+                        fprintf(stdout, "cartesian image of size %d %d on %s\n", o.width, o.height, o.name.c_str());
+
+                        // the fovea is scaled as the sampled image to the reconstruction.
+                        if (fusion) {
+                            const double scale = (double)((o.width < o.height) ? o.width : o.height) / 
+                                                 (double)((g.width < g.height) ? g.width : g.height);
+                            o.fusion = allocFoveaBlendMask(o.mask, o.width, o.height, fovea, scale, blend);
+                        }
+
+                        // the output starts on coarse tables, the exact ones are built in background.
+                        if (!driver)
+                            o.trsf.allocLookupTablesAsync(L2C, necc, nang, o.width, o.height, overlap);
+
+                        // open the out port.
+                        o.out.open(o.name.c_str());
+                    }
+
+                    if (!driver)
+                        workers = new StripeWorkers(nThreads);
                     active = true;
 
                     lp.resize(nang, necc);
-                    
-                    // open the out port.
-                    out.open(outname.c_str());
                 }
             }
         }
@@ -223,13 +401,17 @@ public:
      * called when closing the thread to clean up resources.
      */
     virtual void threadRelease() {
-        trsf.freeLookupTables();
+        for (int i = 0; i < nOutputs; i++) {
+            outputs[i].trsf.freeLookupTables();
+            freeFoveaBlendMask(outputs[i].mask);
+        }
         active = false;
     }
 
     virtual void onStop() {
         poly.close();
-        out.close();
+        for (int i = 0; i < nOutputs; i++)
+            outputs[i].out.close();
     }
 
     /* 
@@ -237,16 +419,58 @@ public:
      */
     virtual void run() {
         while (!isStopping()) {
+            if (active && workers == 0) {
+                RemapOutput& o = outputs[0];
+                ImageOf<PixelRgb>& datum = o.writer.get();
+                if (!lpRecon->getCartesianReconstruction(datum, o.width, o.height))
+                    continue;
+                o.writer.write(true);
+            }
+            else
             if (active) {
-                lpImage->getLogpolarImage(lp);
-                ImageOf<PixelRgb>& datum = writer.get();
-                datum.resize(width, height);
+                // remap straight from the receive buffer when the driver lends it, the fovea
+                // is paired with the logpolar image if read from the combined stream.
+                LogpolarImageView view, fview;
+                bool fov = fusion;
+                if (fusion && lpBundle != 0) {
+                    Stamp stamp;
+                    if (!lpBundle->getLogpolarBundle(lp, fovea, stamp))
+                        continue;
+                }
+                else
+                if (lpBorrow != 0) {
+                    if (!lpBorrow->borrowLogpolarImage(view))
+                        continue;
+                    if (fusion && !lpBorrow->borrowFovealImage(fview))
+                        fov = false;
+                }
+                else {
+                    lpImage->getLogpolarImage(lp);
+                    if (fusion)
+                        fov = lpImage->getFovealImage(fovea);
+                }
+
+                // the exact tables are picked up between two frames, when ready.
+                for (int i = 0; i < nOutputs; i++)
+                    outputs[i].trsf.upgradeLookupTables();
+
+                RemapJob job(outputs, nOutputs);
+                job.lp = view.isValid() ? &view.image() : &lp;
+                job.fovea = fov ? (fview.isValid() ? &fview.image() : &fovea) : 0;
+
+                for (int i = 0; i < nOutputs; i++) {
+                    outputs[i].datum = &outputs[i].writer.get();
+                    outputs[i].datum->resize(outputs[i].width, outputs[i].height);
+                }
 
-                // then remap
-                trsf.logpolarToCart(datum, lp);
+                // then remap all the sizes at once.
+                workers->run(job);
+                view.release();
+                fview.release();
 
-                // then write to out port
-                writer.write(true);
+                // then write to the out ports.
+                for (int i = 0; i < nOutputs; i++)
+                    outputs[i].writer.write(true);
             }
             else {
                 Time::delay(2.0);
@@ -364,6 +588,11 @@ public:
  * --name <string>
  * --width <int>
  * --height <int>
+ * --sizes <list>
+ * --threads <int>
+ * --blend <int>
+ * --no_fovea
+ * --bundle
  *
  */
 int main (int argc, char *argv[]) {
@@ -0,0 +1,316 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * Copyright (C) 2026 The iCub contributors
+ * Authors: see the history of this file in the repository
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * @file logPolarPipeline.cpp
+ * @brief implementation of the pipeline stages of the logpolar transform module.
+ */
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "logPolarTransform.h"
+
+using namespace iCub::logpolar;
+
+void LogPolarTransformWorker::run() {
+    //
+    while (!isStopping()) {
+        LogPolarFrame *frame = in->get();
+        if (frame == 0)
+            break;
+
+        frame->owner->process(frame);
+
+        // a stream being stopped refuses its frames, the other streams are still served.
+        if (!frame->owner->complete(frame))
+            continue;
+    }
+}
+
+void LogPolarTransformWorker::onStop() {
+    in->interrupt();
+}
+
+LogPolarWorkerPool::LogPolarWorkerPool() {
+    queue = 0;
+    workers = 0;
+    nWorkers = 0;
+}
+
+LogPolarWorkerPool::~LogPolarWorkerPool() {
+    stop();
+}
+
+bool LogPolarWorkerPool::start(int n, int capacity) {
+    //
+    if (workers != 0)
+        return false;
+
+    nWorkers = (n > 0) ? n : getNumberOfCores();
+    queue = new LogPolarFrameQueue((capacity > 0) ? capacity : 1);
+
+    workers = new LogPolarTransformWorker *[nWorkers];
+    for (int i = 0; i < nWorkers; i++) {
+        workers[i] = new LogPolarTransformWorker(queue);
+        workers[i]->start();
+    }
+
+    return true;
+}
+
+void LogPolarWorkerPool::stop() {
+    //
+    if (workers) {
+        // stopping the first worker interrupts the shared queue and releases all the others.
+        for (int i = 0; i < nWorkers; i++) {
+            workers[i]->stop();
+            delete workers[i];
+        }
+        delete[] workers;
+        workers = 0;
+        nWorkers = 0;
+    }
+
+    if (queue) delete queue;
+    queue = 0;
+}
+
+int LogPolarWorkerPool::getNumberOfCores() {
+    //
+    int n = 1;
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    n = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (n > 0) ? n : 1;
+}
+
+bool LogPolarTables::Key::operator<(const Key& k) const {
+    //
+    if (mode != k.mode) return mode < k.mode;
+    if (necc != k.necc) return necc < k.necc;
+    if (nang != k.nang) return nang < k.nang;
+    if (width != k.width) return width < k.width;
+    if (height != k.height) return height < k.height;
+    if (overlap != k.overlap) return overlap < k.overlap;
+    return placeholder < k.placeholder;
+}
+
+LogPolarTableCache::~LogPolarTableCache() {
+    //
+    std::map<LogPolarTables::Key, LogPolarTables *>::iterator it;
+    for (it = entries.begin(); it != entries.end(); it++) {
+        delete it->second->trsf;
+        delete it->second;
+    }
+    entries.clear();
+}
+
+LogPolarTables *LogPolarTableCache::acquire(int mode, int necc, int nang, int w, int h, double overlap, bool placeholder) {
+    //
+    LogPolarTables::Key key;
+    key.mode = mode;
+    key.necc = necc;
+    key.nang = nang;
+    key.width = w;
+    key.height = h;
+    key.overlap = overlap;
+    key.placeholder = placeholder;
+
+    mutex.wait();
+    std::map<LogPolarTables::Key, LogPolarTables *>::iterator it = entries.find(key);
+    if (it != entries.end()) {
+        LogPolarTables *e = it->second;
+        e->references++;
+        if (!e->ready) {
+            e->waiting++;
+            mutex.post();
+            e->built.wait();
+        }
+        else
+            mutex.post();
+
+        if (!e->ok) {
+            release(e);
+            return 0;
+        }
+        return e;
+    }
+
+    LogPolarTables *e = new LogPolarTables;
+    e->trsf = new logpolarTransform;
+    e->trsf->setTablePages(pages);
+    e->trsf->setNumaReplicas(numa);
+    e->key = key;
+    e->references = 1;
+    entries[key] = e;
+    mutex.post();
+
+    // the build takes a while, other geometries can be built or shared in the meantime.
+    const bool ok = (placeholder) ?
+        e->trsf->allocPlaceholderTables(mode, necc, nang, w, h, overlap) :
+        e->trsf->allocLookupTables(mode, necc, nang, w, h, overlap);
+
+    mutex.wait();
+    e->ok = ok;
+    e->ready = true;
+    for (int i = 0; i < e->waiting; i++)
+        e->built.post();
+    e->waiting = 0;
+    mutex.post();
+
+    if (!ok) {
+        release(e);
+        return 0;
+    }
+    return e;
+}
+
+void LogPolarTableCache::retain(LogPolarTables *tables) {
+    //
+    if (tables == 0)
+        return;
+
+    mutex.wait();
+    tables->references++;
+    mutex.post();
+}
+
+void LogPolarTableCache::release(LogPolarTables *tables) {
+    //
+    if (tables == 0)
+        return;
+
+    bool dead = false;
+    mutex.wait();
+    if (--tables->references == 0) {
+        entries.erase(tables->key);
+        dead = true;
+    }
+    mutex.post();
+
+    if (dead) {
+        delete tables->trsf;
+        delete tables;
+    }
+}
+
+void LogPolarTableBuildWorker::run() {
+    //
+    while (!isStopping()) {
+        LogPolarTransformThread *stream = in->get();
+        if (stream == 0)
+            break;
+
+        stream->rebuild();
+    }
+}
+
+void LogPolarTableBuildWorker::onStop() {
+    in->interrupt();
+}
+
+bool LogPolarTableBuilder::open(int streams, int n) {
+    //
+    if (queue != 0)
+        return false;
+
+    if (streams <= 0)
+        streams = 1;
+
+    // the builds are CPU bound, more threads than cores only slow them down.
+    const int cores = LogPolarWorkerPool::getNumberOfCores();
+    nWorkers = (n > 0) ? n : ((streams < cores) ? streams : cores);
+
+    queue = new LogPolarQueue<LogPolarTransformThread>(streams);
+    workers = new LogPolarTableBuildWorker *[nWorkers];
+    bool ok = true;
+    for (int i = 0; i < nWorkers; i++) {
+        workers[i] = new LogPolarTableBuildWorker(queue);
+        ok = workers[i]->start() && ok;
+    }
+    return ok;
+}
+
+void LogPolarTableBuilder::close() {
+    //
+    if (queue == 0)
+        return;
+
+    // stopping the first thread interrupts the shared queue and releases all the others.
+    for (int i = 0; i < nWorkers; i++) {
+        workers[i]->stop();
+        delete workers[i];
+    }
+    delete[] workers;
+    workers = 0;
+    nWorkers = 0;
+
+    delete queue;
+    queue = 0;
+}
+
+LogPolarOutputWriter::LogPolarOutputWriter(LogPolarTransformThread *o, LogPolarFrameQueue *i, LogPolarFrameQueue *f, int frames) {
+    owner = o;
+    in = i;
+    freeFrames = f;
+    nFrames = frames;
+    next = 0;
+    pending = new LogPolarFrame *[frames];
+    for (int k = 0; k < frames; k++)
+        pending[k] = 0;
+}
+
+LogPolarOutputWriter::~LogPolarOutputWriter() {
+    delete[] pending;
+}
+
+void LogPolarOutputWriter::run() {
+    //
+    while (!isStopping()) {
+        LogPolarFrame *frame = in->get();
+        if (frame == 0)
+            break;
+
+        // sequence numbers of the frames in flight never differ by more than the pool size.
+        pending[frame->seq % nFrames] = frame;
+
+        LogPolarFrame *f;
+        while ((f = pending[next % nFrames]) != 0 && f->seq == next) {
+            pending[next % nFrames] = 0;
+            owner->emit(f);
+            next++;
+
+            if (!freeFrames->put(f))
+                return;
+        }
+    }
+}
+
+void LogPolarOutputWriter::onStop() {
+    in->interrupt();
+    freeFrames->interrupt();
+}
+
@@ -0,0 +1,386 @@
+// -*- mode:C++; tab-width:4; c-basic-offset:4; indent-tabs-mode:nil -*-
+
+/*
+ * Copyright (C) 2026 The iCub contributors
+ * Authors: see the history of this file in the repository
+ * Permission is granted to copy, distribute, and/or modify this program
+ * under the terms of the GNU General Public License, version 2 or any
+ * later version published by the Free Software Foundation.
+ *
+ * A copy of the license can be found at
+ * http://www.robotcub.org/icub/license/gpl.txt
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details
+ */
+
+/**
+ * @file logPolarPipeline.h
+ * @brief the pipeline stages of the logpolar transform module: frames, bounded queues,
+ * the shared pool of transform workers, the output writer and the cache of lookup tables
+ * shared among streams.
+ */
+
+#ifndef __ICUB_LOGPOLARPIPELINE_H__
+#define __ICUB_LOGPOLARPIPELINE_H__
+
+#include <map>
+
+#include <yarp/sig/all.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Semaphore.h>
+#include <yarp/os/Stamp.h>
+
+#include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+
+class LogPolarTransformThread;
+struct LogPolarTables;
+
+/**
+ * a frame travelling through the pipeline, from the input port reader
+ * to the transform workers and then to the output writer. Frames are
+ * preallocated and recycled, so no image is allocated at run time.
+ */
+struct LogPolarFrame
+{
+    LogPolarTransformThread *owner;                 /**< the stream the frame belongs to */
+    int seq;                                        /**< sequence number, used to preserve the input order */
+    yarp::os::Stamp stamp;                          /**< envelope of the input image */
+    LogPolarTables *tables;                         /**< the tables the frame is transformed with (a reference is held) */
+    int angles;                                     /**< geometry of the tables: number of angles */
+    int rings;                                      /**< number of rings */
+    int width;                                      /**< width of the cartesian image */
+    int height;                                     /**< height of the cartesian image */
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> input;  /**< copy of the input image */
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> lp;     /**< logpolar output (C2L and bidirectional) */
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> cart;   /**< cartesian output (L2C and bidirectional) */
+    double psnr;                                    /**< round-trip PSNR (bidirectional), negative if not computed */
+    bool skip;                                      /**< the input doesn't match the tables, nothing is written */
+};
+
+/**
+ * a bounded FIFO of pointers to T. put() blocks while the queue is full and get()
+ * blocks while the queue is empty; interrupt() releases all the waiting threads
+ * (get() then returns 0 and put() returns false).
+ */
+template <class T>
+class LogPolarQueue
+{
+private:
+    T **ring;
+    int capacity;
+    int head;
+    int count;
+    int waiters;
+    bool closing;
+
+    yarp::os::Semaphore mutex;
+    yarp::os::Semaphore slots;
+    yarp::os::Semaphore items;
+
+    LogPolarQueue(const LogPolarQueue&);
+    void operator=(const LogPolarQueue&);
+
+public:
+    LogPolarQueue(int size) : mutex(1), slots(size), items(0) {
+        ring = new T*[size];
+        capacity = size;
+        head = 0;
+        count = 0;
+        waiters = 0;
+        closing = false;
+    }
+
+    ~LogPolarQueue() {
+        delete[] ring;
+    }
+
+    bool put(T *x) {
+        mutex.wait();
+        if (closing) { mutex.post(); return false; }
+        waiters++;
+        mutex.post();
+
+        slots.wait();
+
+        mutex.wait();
+        waiters--;
+        if (closing) { mutex.post(); return false; }
+        ring[(head + count) % capacity] = x;
+        count++;
+        mutex.post();
+
+        items.post();
+        return true;
+    }
+
+    T *get() {
+        mutex.wait();
+        if (closing) { mutex.post(); return 0; }
+        waiters++;
+        mutex.post();
+
+        items.wait();
+
+        mutex.wait();
+        waiters--;
+        if (closing) { mutex.post(); return 0; }
+        T *x = ring[head];
+        head = (head + 1) % capacity;
+        count--;
+        mutex.post();
+
+        slots.post();
+        return x;
+    }
+
+    void interrupt() {
+        mutex.wait();
+        closing = true;
+        const int n = waiters;
+        mutex.post();
+
+        for (int i = 0; i < n; i++) {
+            slots.post();
+            items.post();
+        }
+    }
+};
+
+typedef LogPolarQueue<LogPolarFrame> LogPolarFrameQueue;
+
+/**
+ * the transform stage: takes frames from the input queue, has them transformed 
+ * by the stream they belong to and passes them on to the stream output stage.
+ * All the workers share the same input queue.
+ */
+class LogPolarTransformWorker : public yarp::os::Thread
+{
+private:
+    LogPolarFrameQueue *in;
+
+public:
+    LogPolarTransformWorker(LogPolarFrameQueue *i) : in(i) {}
+
+    void run();
+    void onStop();
+};
+
+/**
+ * the pool of transform workers shared by all the streams of the module.
+ * Idle workers pick up the next frame of any stream, thus the load is
+ * balanced among streams without oversubscribing the cores.
+ */
+class LogPolarWorkerPool
+{
+private:
+    LogPolarFrameQueue *queue;
+    LogPolarTransformWorker **workers;
+    int nWorkers;
+
+    LogPolarWorkerPool(const LogPolarWorkerPool&);
+    void operator=(const LogPolarWorkerPool&);
+
+public:
+    LogPolarWorkerPool();
+    ~LogPolarWorkerPool();
+
+    /**
+     * start the workers.
+     * @param n is the number of workers, zero or negative for one per core.
+     * @param capacity is the maximum number of frames waiting to be transformed.
+     * @return true iff successful.
+     */
+    bool start(int n, int capacity);
+
+    /**
+     * stop and join the workers (pending frames are dropped).
+     */
+    void stop();
+
+    /**
+     * queue a frame for transformation, blocks while the queue is full.
+     * @param frame is the frame, whose owner is called by the worker.
+     * @return false if the pool is stopping.
+     */
+    bool submit(LogPolarFrame *frame) { return (queue != 0) ? queue->put(frame) : false; }
+
+    /**
+     * @return the number of running workers.
+     */
+    int size() const { return nWorkers; }
+
+    /**
+     * @return the number of cores available on this host.
+     */
+    static int getNumberOfCores();
+};
+
+/**
+ * the lookup tables of a geometry, shared through the table cache by the streams and by
+ * the frames in flight. The entry carries its own key and reference count, thus retaining
+ * and releasing it doesn't look it up in the cache.
+ */
+struct LogPolarTables
+{
+    struct Key {
+        int mode, necc, nang, width, height;
+        double overlap;
+        bool placeholder;
+        bool operator<(const Key& k) const;
+    };
+
+    iCub::logpolar::logpolarTransform *trsf;    /**< the transform, with its lookup tables */
+
+    // the bookkeeping of the cache.
+    Key key;
+    int references;
+    bool ready;                 // tables built (successfully or not)
+    bool ok;
+    int waiting;                // number of streams waiting for the build
+    yarp::os::Semaphore built;
+
+    LogPolarTables() : trsf(0), references(0), ready(false), ok(false), waiting(0), built(0) {}
+};
+
+/**
+ * a cache of lookup tables keyed by geometry. Streams with the very same geometry
+ * and mode share one logpolarTransform object; tables are freed when the last stream
+ * releases them. Tables are built outside of the cache lock, a stream requesting tables
+ * still under construction waits for them. The coarse placeholder tables, which streams
+ * serve with while the exact ones are built, are cached separately.
+ */
+class LogPolarTableCache
+{
+private:
+    std::map<LogPolarTables::Key, LogPolarTables *> entries;
+    yarp::os::Semaphore mutex;
+    int pages;                      // placement of the tables built
+    bool numa;
+
+    LogPolarTableCache(const LogPolarTableCache&);
+    void operator=(const LogPolarTableCache&);
+
+public:
+    LogPolarTableCache() : mutex(1), pages(iCub::logpolar::PAGES_DEFAULT), numa(false) {}
+    ~LogPolarTableCache();
+
+    /**
+     * choose where the tables built from now on are allocated.
+     * @param p is one of PAGES_DEFAULT, PAGES_TRANSPARENT or PAGES_HUGE.
+     * @param n is true to replicate the tables on each NUMA node.
+     */
+    void setPlacement(int p, bool n) { pages = p; numa = n; }
+
+    /**
+     * get the tables of a given geometry, building them if needed.
+     * @param mode is one of C2L, L2C or BOTH.
+     * @param necc is the number of rings.
+     * @param nang is the number of angles.
+     * @param w is the width of the cartesian image.
+     * @param h is the height of the cartesian image.
+     * @param overlap is the overlap of the receptive fields.
+     * @param placeholder asks for the nearest neighbour placeholder tables instead of the exact ones.
+     * @return the shared tables or 0 in case of failure.
+     */
+    LogPolarTables *acquire(int mode, int necc, int nang, int w, int h, double overlap, bool placeholder = false);
+
+    /**
+     * get a further reference to tables obtained by acquire.
+     * @param tables are the tables.
+     */
+    void retain(LogPolarTables *tables);
+
+    /**
+     * release tables previously obtained by acquire or retain.
+     * @param tables are the tables.
+     */
+    void release(LogPolarTables *tables);
+};
+
+/**
+ * a thread of the table builder: builds the tables of the streams taken from the queue
+ * of the builder. All the threads share the same queue.
+ */
+class LogPolarTableBuildWorker : public yarp::os::Thread
+{
+private:
+    LogPolarQueue<LogPolarTransformThread> *in;
+
+public:
+    LogPolarTableBuildWorker(LogPolarQueue<LogPolarTransformThread> *i) : in(i) {}
+
+    void run();
+    void onStop();
+};
+
+/**
+ * the table builder: builds the exact tables of the streams started on the placeholder
+ * ones and rebuilds the tables of the streams whose geometry has been changed at run time,
+ * so that the streams keep serving with the tables they have in the meantime. A few threads
+ * build the tables of different streams concurrently (streams of the same geometry share 
+ * the build through the table cache).
+ */
+class LogPolarTableBuilder
+{
+private:
+    LogPolarQueue<LogPolarTransformThread> *queue;
+    LogPolarTableBuildWorker **workers;
+    int nWorkers;
+
+    LogPolarTableBuilder(const LogPolarTableBuilder&);
+    void operator=(const LogPolarTableBuilder&);
+
+public:
+    LogPolarTableBuilder() : queue(0), workers(0), nWorkers(0) {}
+    ~LogPolarTableBuilder() { close(); }
+
+    /**
+     * start the builder.
+     * @param streams is the number of streams, each stream is queued at most once.
+     * @param n is the number of threads, zero or negative for one per stream (up to one per core).
+     * @return true iff successful.
+     */
+    bool open(int streams, int n = 0);
+
+    /**
+     * stop the builder, waiting for the builds in progress.
+     */
+    void close();
+
+    /**
+     * queue a stream for rebuilding its tables.
+     * @param stream is the stream, its rebuild() method is called by the builder.
+     * @return false if the builder is stopping.
+     */
+    bool submit(LogPolarTransformThread *stream) { return (queue != 0) ? queue->put(stream) : false; }
+};
+
+/**
+ * the output stage: writes the transformed frames to the output ports in the
+ * order they have been read (workers might complete them out of order) and
+ * recycles them to the pool of free frames.
+ */
+class LogPolarOutputWriter : public yarp::os::Thread
+{
+private:
+    LogPolarTransformThread *owner;
+    LogPolarFrameQueue *in;
+    LogPolarFrameQueue *freeFrames;
+    LogPolarFrame **pending;
+    int nFrames;
+    int next;
+
+public:
+    LogPolarOutputWriter(LogPolarTransformThread *o, LogPolarFrameQueue *i, LogPolarFrameQueue *f, int frames);
+    ~LogPolarOutputWriter();
+
+    void run();
+    void onStop();
+};
+
+#endif // __ICUB_LOGPOLARPIPELINE_H__
+//empty line to make gcc happy
+
@@ -31,6 +31,7 @@
  * @brief implementation of the logpolar transform module classes (generic logpolar module).
  */
 #include <memory.h>
+#include <cmath>
 
 #include "logPolarTransform.h"
 
@@ -40,98 +41,191 @@ using namespace std;
 
 using namespace iCub::logpolar;
 
-bool LogPolarTransform::configure(yarp::os::ResourceFinder &rf)
-{    
-   /* Process all parameters from both command-line and .ini file */
-
-   /* get the module name which will form the stem of all module port names */
+/* a stream parameter is looked up in the stream group first and then among the module parameters */
+static Value findStreamValue(ResourceFinder &rf, Bottle &group, const char *key, const Value& def, const char *comment)
+{
+   if (!group.isNull() && group.check(key))
+      return group.find(key);
+   return rf.check(key, def, comment);
+}
 
-   moduleName            = rf.check("name", 
-                           Value("logpolarTransform"), 
-                           "module name (string)").asString();
+bool LogPolarTransform::readStreamParameters(ResourceFinder &rf, const string& stream, LogPolarStreamParameters& p)
+{
+   Bottle none;
+   Bottle &group = (stream == "") ? none : rf.findGroup(stream.c_str());
 
-   /*
-    * before continuing, set the module name before getting any other parameters, 
-    * specifically the port names which are dependent on the module name
-    */
-   
-   setName(moduleName.c_str());
+   p.name = stream;
 
    /* get the name of the input and output ports, automatically prefixing the module name by using getName() */
 
-   inputPortName         = "/";
-   inputPortName        += getName(
-                           rf.check("imageInputPort", 
+   const string prefix = (stream == "") ? string("") : string("/") + stream;
+
+   p.inputPortName       = "/";
+   p.inputPortName      += getName((prefix +
+                           findStreamValue(rf, group, "imageInputPort", 
                            Value("/image:i"),
-                           "Input image port (string)").asString()
+                           "Input image port (string)").asString().c_str()).c_str()
                            );
    
-   outputPortName        = "/";
-   outputPortName       += getName(
-                           rf.check("imageOutputPort", 
+   p.outputPortName      = "/";
+   p.outputPortName     += getName((prefix +
+                           findStreamValue(rf, group, "imageOutputPort", 
                            Value("/image:o"),
-                           "Output image port (string)").asString()
+                           "Output image port (string)").asString().c_str()).c_str()
+                           );
+
+   p.cartOutputPortName  = "/";
+   p.cartOutputPortName += getName((prefix +
+                           findStreamValue(rf, group, "cartOutputPort", 
+                           Value("/cart:o"),
+                           "Reconstructed image output port, bidirectional only (string)").asString().c_str()).c_str()
+                           );
+
+   p.psnrOutputPortName  = "/";
+   p.psnrOutputPortName += getName((prefix +
+                           findStreamValue(rf, group, "psnrOutputPort", 
+                           Value("/psnr:o"),
+                           "Round-trip PSNR output port, bidirectional only (string)").asString().c_str()).c_str()
                            );
 
    /* get the direction of the transform */
 
-   transformDirection    = rf.check("direction",
+   string transformDirection = findStreamValue(rf, group, "direction",
                            Value("CARTESIAN2LOGPOLAR"),
-                           "Key value (int)").asString();
+                           "Key value (int)").asString().c_str();
 
-   cout << "Configuration of logpolar " << transformDirection << endl;
+   cout << "Configuration of logpolar " << stream << " " << transformDirection << endl;
 
    if (transformDirection == "CARTESIAN2LOGPOLAR") {
-      direction = CARTESIAN2LOGPOLAR;
+      p.direction = CARTESIAN2LOGPOLAR;
+   }
+   else if (transformDirection == "BIDIRECTIONAL") {
+      p.direction = BIDIRECTIONAL;
    }
    else {
-      direction = LOGPOLAR2CARTESIAN;
+      p.direction = LOGPOLAR2CARTESIAN;
    }
 
    /* get the number of angles */
 
-   numberOfAngles        = rf.check("angles",
+   p.numberOfAngles      = findStreamValue(rf, group, "angles",
                            Value(252),
                            "Key value (int)").asInt();
 
    /* get the number of rings */
 
-   numberOfRings         = rf.check("rings",
+   p.numberOfRings       = findStreamValue(rf, group, "rings",
                            Value(152),
                            "Key value (int)").asInt();
  
    /* get the size of the X dimension */
 
-   xSize                 = rf.check("xsize",
+   p.xSize               = findStreamValue(rf, group, "xsize",
                            Value(320),
                            "Key value (int)").asInt();
 
    /* get the size of the Y dimension */
 
-   ySize                 = rf.check("ysize",
+   p.ySize               = findStreamValue(rf, group, "ysize",
                            Value(240),
                            "Key value (int)").asInt();
 
 
    /* get the overlap ratio */
 
-   overlap               = rf.check("overlap",
+   p.overlap             = findStreamValue(rf, group, "overlap",
                            Value(1.0),
                            "Key value (int)").asDouble();
 
+   /* get the number of frames in flight: at least one being read, one transformed and one written */
 
-   /* do all initialization here */
-     
-   /* open ports  */ 
-       
-   if (!imageIn.open(inputPortName.c_str())) {
-      cout << getName() << ": unable to open port " << inputPortName << endl;
-      return false;  // unable to open; let RFModule know so that it won't run
+   p.frames              = findStreamValue(rf, group, "frames",
+                           Value(4),
+                           "Key value (int)").asInt();
+   if (p.frames < 3)
+      p.frames = 3;
+
+   return true;
+}
+
+bool LogPolarTransform::configure(yarp::os::ResourceFinder &rf)
+{    
+   /* Process all parameters from both command-line and .ini file */
+
+   /* get the module name which will form the stem of all module port names */
+
+   moduleName            = rf.check("name", 
+                           Value("logpolarTransform"), 
+                           "module name (string)").asString();
+
+   /*
+    * before continuing, set the module name before getting any other parameters, 
+    * specifically the port names which are dependent on the module name
+    */
+   
+   setName(moduleName.c_str());
+
+   /* get the number of transform workers, one per core by default */
+
+   workers               = rf.check("workers",
+                           Value(0),
+                           "Key value (int)").asInt();
+
+   /* get the placement of the lookup tables, shared by all the streams */
+
+   const string pagesName = rf.check("pages",
+                           Value("default"),
+                           "Table pages default|transparent|huge (string)").asString().c_str();
+
+   if (pagesName == "transparent")
+      pages = PAGES_TRANSPARENT;
+   else
+   if (pagesName == "huge")
+      pages = PAGES_HUGE;
+   else
+      pages = PAGES_DEFAULT;
+
+   numa = rf.check("numa");
+   cache.setPlacement(pages, numa);
+
+   /* get the list of streams, a single stream configured by the top level parameters if missing */
+
+   Bottle *names         = rf.check("streams",
+                           Value(""),
+                           "List of stream names (list)").asList();
+
+   nStreams = (names != 0 && names->size() > 0) ? names->size() : 1;
+
+   LogPolarStreamParameters *params = new LogPolarStreamParameters[nStreams];
+   int capacity = 0;
+   for (int i = 0; i < nStreams; i++) {
+      const string stream = (names != 0 && names->size() > 0) ? names->get(i).asString().c_str() : "";
+      readStreamParameters(rf, stream, params[i]);
+      capacity += params[i].frames;
    }
 
-   if (!imageOut.open(outputPortName.c_str())) {
-      cout << getName() << ": unable to open port " << outputPortName << endl;
-      return false;  // unable to open; let RFModule know so that it won't run
+   /* do all initialization here */
+
+   /* the pool can hold all the frames of all the streams, submitting a frame never blocks */
+   pool.start(workers, capacity);
+   cout << getName() << ": " << nStreams << " streams served by " << pool.size() << " workers ("
+        << kernelInstructionSet() << " kernels)" << endl;
+
+   /* the tables of a stream reconfigured at run time are built in background */
+   builder.open(nStreams);
+
+   /* create the streams and open their ports */
+
+   streams = new LogPolarTransformThread *[nStreams];
+   for (int i = 0; i < nStreams; i++)
+      streams[i] = new LogPolarTransformThread(params[i], &pool, &cache, &builder);
+   delete[] params;
+
+   for (int i = 0; i < nStreams; i++) {
+      if (!streams[i]->open()) {
+         close();       // the streams, their ports, the builder and the workers go
+         return false;  // unable to open; let RFModule know so that it won't run
+      }
    }
 
    /*
@@ -144,6 +238,7 @@ bool LogPolarTransform::configure(yarp::os::ResourceFinder &rf)
  
    if (!handlerPort.open(handlerPortName.c_str())) {           
       cout << getName() << ": Unable to open port " << handlerPortName << endl;  
+      close();
       return false;
    }
 
@@ -152,17 +247,10 @@ bool LogPolarTransform::configure(yarp::os::ResourceFinder &rf)
    //attachTerminal();                     // attach to terminal
 
 
-   /* create the thread and pass pointers to the module parameters */
-
-   logPolarTransformThread = new LogPolarTransformThread(&imageIn, &imageOut, 
-                                                         &direction, 
-                                                         &xSize, &ySize,
-                                                         &numberOfAngles, &numberOfRings, 
-                                                         &overlap);
-
-   /* now start the thread to do the work */
+   /* now start the streams to do the work */
 
-   logPolarTransformThread->start(); // this calls threadInit() and it if returns true, it then calls run()
+   for (int i = 0; i < nStreams; i++)
+      streams[i]->start(); // this calls threadInit() and it if returns true, it then calls run()
 
    return true ;      // let the RFModule know everything went well
                       // so that it will then run the module
@@ -171,8 +259,6 @@ bool LogPolarTransform::configure(yarp::os::ResourceFinder &rf)
 
 bool LogPolarTransform::interruptModule()
 {
-//    imageIn.interrupt();
-//    imageOut.interrupt();
     handlerPort.interrupt();
 
     return true;
@@ -181,13 +267,25 @@ bool LogPolarTransform::interruptModule()
 
 bool LogPolarTransform::close()
 {
-//    imageIn.close();
-//    imageOut.close();
     handlerPort.close();
 
-    /* stop the thread */
+    /* stop the builder, the streams, then the workers which might still hold their frames, then free them */
 
-    logPolarTransformThread->stop();
+    builder.close();
+
+    for (int i = 0; i < nStreams; i++)
+        streams[i]->stop();
+
+    pool.stop();
+
+    for (int i = 0; i < nStreams; i++) {
+        streams[i]->close();
+        delete streams[i];
+    }
+
+    if (streams) delete[] streams;
+    streams = 0;
+    nStreams = 0;
 
     return true;
 }
@@ -198,7 +296,10 @@ bool LogPolarTransform::respond(const Bottle& command, Bottle& reply)
     string helpMessage =  string(getName().c_str()) + 
                         " commands are: \n" +  
                         "help \n" + 
-                        "quit \n";
+                        "quit \n" +
+                        "set angles <n> [stream] \n" +
+                        "set rings <n> [stream] \n" +
+                        "set overlap <x> [stream] \n";
     reply.clear(); 
 
     if (command.get(0).asString()=="quit") {
@@ -209,6 +310,37 @@ bool LogPolarTransform::respond(const Bottle& command, Bottle& reply)
         cout << helpMessage;
         reply.addString("ok");
     }
+    else if (command.get(0).asString()=="set" && command.size() >= 3) {
+        const string param = command.get(1).asString().c_str();
+        const string stream = (command.size() > 3) ? command.get(3).asString().c_str() : "";
+
+        bool found = false;
+        bool ok = true;
+        for (int i = 0; i < nStreams; i++) {
+            if (stream != "" && stream != streams[i]->getStreamName())
+                continue;
+
+            int angles, rings;
+            double ovl;
+            streams[i]->getGeometry(angles, rings, ovl);
+
+            if (param == "angles")
+                angles = command.get(2).asInt();
+            else if (param == "rings")
+                rings = command.get(2).asInt();
+            else if (param == "overlap")
+                ovl = command.get(2).asDouble();
+            else {
+                ok = false;
+                break;
+            }
+
+            found = true;
+            ok = streams[i]->setGeometry(angles, rings, ovl) && ok;
+        }
+
+        reply.addString((found && ok) ? "ok" : "failed");
+    }
     return true;
 }
 
@@ -229,107 +361,416 @@ double LogPolarTransform::getPeriod()
    return 0.1;
 }
 
-LogPolarTransformThread::LogPolarTransformThread(BufferedPort<FlexImage> *imageIn, BufferedPort<ImageOf<PixelRgb> > *imageOut, 
-                                                 int *direction, int *x, int *y, int *angles, int *rings, double *overlap)
+LogPolarTransformThread::LogPolarTransformThread(const LogPolarStreamParameters& p, LogPolarWorkerPool *workers, LogPolarTableCache *tables, LogPolarTableBuilder *tableBuilder) : mutex(1)
 {
-    imagePortIn        = imageIn;
-    imagePortOut       = imageOut;
-    directionValue     = direction;
-    xSizeValue         = x;
-    ySizeValue         = y;
-    anglesValue        = angles;
-    ringsValue         = rings;
-    overlapValue       = overlap;
-    inputImage = 0;
+    params = p;
+    pool = workers;
+    cache = tables;
+    builder = tableBuilder;
+    tables = 0;
+
+    initialized = false;
+    rebuildQueued = false;
+    requestedAngles = p.numberOfAngles;
+    requestedRings = p.numberOfRings;
+    requestedOverlap = p.overlap;
+    next = 0;
+    nextAngles = 0;
+    nextRings = 0;
+    nextOverlap = 0.;
+
+    frames = 0;
+    nFrames = 0;
+    sequence = 0;
+    freeFrames = 0;
+    doneFrames = 0;
+    writer = 0;
+}
+
+LogPolarTransformThread::~LogPolarTransformThread() {
+    releasePipeline();
+}
+
+bool LogPolarTransformThread::open() {
+    //
+    if (!imagePortIn.open(params.inputPortName.c_str())) {
+        cout << "unable to open port " << params.inputPortName << endl;
+        return false;
+    }
+
+    if (!imagePortOut.open(params.outputPortName.c_str())) {
+        cout << "unable to open port " << params.outputPortName << endl;
+        return false;
+    }
+
+    if (params.direction == BIDIRECTIONAL) {
+        if (!cartPortOut.open(params.cartOutputPortName.c_str())) {
+            cout << "unable to open port " << params.cartOutputPortName << endl;
+            return false;
+        }
+
+        if (!psnrPortOut.open(params.psnrOutputPortName.c_str())) {
+            cout << "unable to open port " << params.psnrOutputPortName << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void LogPolarTransformThread::close() {
+    imagePortIn.close();
+    imagePortOut.close();
+    cartPortOut.close();
+    psnrPortOut.close();
 }
 
 bool LogPolarTransformThread::threadInit() 
 {
+    /* the first image is read in run() so that the streams start concurrently, the exact
+       tables of different streams are then built concurrently by the table builder */
+    return true;
+}
+
+/* the reading stage, sync'ed on the input port */
+void LogPolarTransformThread::run() {
     /* grab an image to set the image size */
     FlexImage *image;
     do {
-        image = imagePortIn->read(true);
+        image = imagePortIn.read(true);
     } while (image == NULL && !isStopping());
 
     if (isStopping())
-        return false;
+        return;
 
     const int width  = image->width();
     const int height = image->height();
-    // the logpolar mapping has always depth 3 (RGB) but we need to copy the input image in case it's monochrome.
-    const int depth = 3; 
- 
-    cout << "||| logPolarTransformThread: width = " << *xSizeValue << " height = " << *ySizeValue << endl;
-    cout << "||| logPolarTransformThread: angles = " << *anglesValue << " rings = " << *ringsValue << endl;
 
     /* create the input image of the correct resolution  */
-    if (*directionValue == CARTESIAN2LOGPOLAR) {
-        *xSizeValue = width;
-        *ySizeValue = height;
+    mutex.wait();
+    if (params.direction == CARTESIAN2LOGPOLAR || params.direction == BIDIRECTIONAL) {
+        params.xSize = width;
+        params.ySize = height;
     }
 
-    cout << "||| initializing the logpolar mapping" << endl;
-    if (!allocLookupTables(*directionValue, *ringsValue, *anglesValue, *xSizeValue, *ySizeValue, *overlapValue)) {
+    /* the geometry might have been changed before the first image */
+    params.numberOfAngles = requestedAngles;
+    params.numberOfRings = requestedRings;
+    params.overlap = requestedOverlap;
+    initialized = true;
+    mutex.post();
+
+    cout << "||| stream " << params.name << ": width = " << params.xSize << " height = " << params.ySize << endl;
+    cout << "||| stream " << params.name << ": angles = " << params.numberOfAngles << " rings = " << params.numberOfRings << endl;
+
+    /* streams sharing the same geometry share the tables, the stream starts on the
+       placeholder tables and the exact ones are swapped in when the builder is done */
+    tables = cache->acquire(getMode(), params.numberOfRings, params.numberOfAngles, params.xSize, params.ySize, params.overlap, true);
+    if (tables == 0) {
         cerr << "can't allocate lookup tables" << endl;
-        return false;
+        return;
     }
-    cout << "||| lookup table allocation done" << endl;
+    cout << "||| placeholder lookup table allocation done" << endl;
 
-    inputImage = new ImageOf<PixelRgb>;
-    inputImage->resize(width, height);
+    mutex.wait();
+    if (!rebuildQueued) {
+        rebuildQueued = true;
+        if (!builder->submit(this))
+            rebuildQueued = false;
+    }
+    mutex.post();
+
+    nFrames = params.frames;
+    sequence = 0;
+
+    frames = new LogPolarFrame[nFrames];
+    freeFrames = new LogPolarFrameQueue(nFrames);
+    doneFrames = new LogPolarFrameQueue(nFrames);
+
+    for (int i = 0; i < nFrames; i++) {
+        // the logpolar mapping has always depth 3 (RGB) but we need to copy the input image in case it's monochrome.
+        frames[i].owner = this;
+        frames[i].tables = 0;
+        frames[i].skip = false;
+        frames[i].input.resize(width, height);
+        freeFrames->put(&frames[i]);
+    }
 
-    return true;
+    writer = new LogPolarOutputWriter(this, doneFrames, freeFrames, nFrames);
+    writer->start();
+
+    while (isStopping() != true) {
+        LogPolarFrame *frame = freeFrames->get();
+        if (frame == 0)
+            break;
+
+        image = imagePortIn.read(true);
+        if (image == 0) {
+            freeFrames->put(frame);
+            continue;
+        }
+
+        // new tables are swapped in between two frames, the frames in flight hold on to the old ones.
+        swapTables();
+        frame->tables = tables;
+        frame->angles = params.numberOfAngles;
+        frame->rings = params.numberOfRings;
+        frame->width = params.xSize;
+        frame->height = params.ySize;
+        cache->retain(tables);
+
+        // copies the input image (generic) into a PixelRgb image.
+        frame->input.copy(*image);
+        imagePortIn.getEnvelope(frame->stamp);
+        frame->seq = sequence++;
+
+        if (!pool->submit(frame))
+            break;
+    }
 }
 
-void LogPolarTransformThread::run() {
+void LogPolarTransformThread::onStop() {
+    imagePortIn.interrupt();
+    if (freeFrames) freeFrames->interrupt();
+}
+
+void LogPolarTransformThread::process(LogPolarFrame *frame) {
     //
-    while (isStopping() != true) {
-        FlexImage *image = imagePortIn->read(true);
-        if (image != 0) 
-        {
-            // copies the input image (generic) into a PixelRgb image.
-            inputImage->copy(*image);
+    frame->psnr = -1.0;
+
+    // the tables don't check the size of the input, an image of another size (e.g. the
+    // logpolar image of a sender with a different geometry) would be read past its end.
+    if (params.direction == LOGPOLAR2CARTESIAN)
+        frame->skip = (frame->input.width() != frame->angles || frame->input.height() != frame->rings);
+    else
+        frame->skip = (frame->input.width() != frame->width || frame->input.height() != frame->height);
+    if (frame->skip)
+        return;
+
+    if (params.direction == CARTESIAN2LOGPOLAR) {
+        frame->lp.resize(frame->angles, frame->rings);
+        frame->tables->trsf->cartToLogpolar(frame->lp, frame->input);
+    }
+    else if (params.direction == BIDIRECTIONAL) {
+        // the reconstruction is computed from the very same logpolar buffer that is sent out.
+        frame->lp.resize(frame->angles, frame->rings);
+        frame->tables->trsf->cartToLogpolar(frame->lp, frame->input);
 
-            if (*directionValue == CARTESIAN2LOGPOLAR) {
-                //
-                ImageOf<PixelRgb> &outputImage = imagePortOut->prepare();
-                outputImage.resize(*anglesValue,*ringsValue);
+        frame->cart.resize(frame->width, frame->height);
+        frame->tables->trsf->logpolarToCart(frame->cart, frame->lp);
 
-                trsf.cartToLogpolar(outputImage, *inputImage);
+        if (psnrPortOut.getOutputCount() > 0)
+            frame->psnr = computePSNR(frame->input, frame->cart);
+    }
+    else {
+        frame->cart.resize(frame->width, frame->height);
+        frame->tables->trsf->logpolarToCart(frame->cart, frame->input);
+    }
+}
 
-                imagePortOut->write();
-            }
-            else {
-                ImageOf<PixelRgb> &outputImage = imagePortOut->prepare();
-                outputImage.resize(*xSizeValue,*ySizeValue);
+void LogPolarTransformThread::emit(LogPolarFrame *frame) {
+    //
+    if (frame->skip) {
+        // nothing to write, the tables are released all the same.
+        cache->release(frame->tables);
+        frame->tables = 0;
+        return;
+    }
 
-                trsf.logpolarToCart(outputImage, *inputImage);
+    if (params.direction == CARTESIAN2LOGPOLAR || params.direction == BIDIRECTIONAL) {
+        imagePortOut.prepare() = frame->lp;
+        imagePortOut.setEnvelope(frame->stamp);
+        imagePortOut.write();
+    }
 
-                imagePortOut->write();
-            }
+    if (params.direction == BIDIRECTIONAL) {
+        cartPortOut.prepare() = frame->cart;
+        cartPortOut.setEnvelope(frame->stamp);
+        cartPortOut.write();
+
+        if (frame->psnr >= 0.) {
+            Bottle &psnr = psnrPortOut.prepare();
+            psnr.clear();
+            psnr.addDouble(frame->psnr);
+            psnrPortOut.setEnvelope(frame->stamp);
+            psnrPortOut.write();
         }
     }
+    else if (params.direction == LOGPOLAR2CARTESIAN) {
+        imagePortOut.prepare() = frame->cart;
+        imagePortOut.setEnvelope(frame->stamp);
+        imagePortOut.write();
+    }
+
+    // the tables are freed with the last frame using them.
+    cache->release(frame->tables);
+    frame->tables = 0;
 }
 
-void LogPolarTransformThread::threadRelease() {
-    if (inputImage) delete inputImage;
-    inputImage = 0;
-    freeLookupTables();
+int LogPolarTransformThread::getMode() const {
+    return (params.direction == CARTESIAN2LOGPOLAR) ? C2L : 
+           (params.direction == BIDIRECTIONAL) ? BOTH : L2C;
+}
+
+void LogPolarTransformThread::getGeometry(int& angles, int& rings, double& overlap) {
+    mutex.wait();
+    angles = requestedAngles;
+    rings = requestedRings;
+    overlap = requestedOverlap;
+    mutex.post();
 }
 
-bool LogPolarTransformThread::allocLookupTables(int which, int necc, int nang, int w, int h, double overlap) {
+bool LogPolarTransformThread::setGeometry(int angles, int rings, double overlap) {
     //
-    if (which == CARTESIAN2LOGPOLAR)
-        trsf.allocLookupTables(C2L, necc, nang, w, h, overlap);
-    else {
-        trsf.allocLookupTables(L2C, necc, nang, w, h, overlap);
+    if (angles <= 0 || rings <= 0 || overlap < 0.)
+        return false;
+
+    mutex.wait();
+    // the size of the logpolar input is set by the sender, not by the tables of this stream.
+    if (params.direction == LOGPOLAR2CARTESIAN && (angles != requestedAngles || rings != requestedRings)) {
+        mutex.post();
+        return false;
     }
+
+    requestedAngles = angles;
+    requestedRings = rings;
+    requestedOverlap = overlap;
+
+    // before the first image the geometry is simply picked up by the initialization.
+    if (initialized && !rebuildQueued) {
+        rebuildQueued = true;
+        if (!builder->submit(this))
+            rebuildQueued = false;
+    }
+    mutex.post();
+
     return true;
 }
 
-bool LogPolarTransformThread::freeLookupTables() {
-    trsf.freeLookupTables();
-    return true;
+void LogPolarTransformThread::rebuild() {
+    //
+    mutex.wait();
+    rebuildQueued = false;
+    const int angles = requestedAngles;
+    const int rings = requestedRings;
+    const double ovl = requestedOverlap;
+    const int width = params.xSize;
+    const int height = params.ySize;
+    mutex.post();
+
+    cout << "||| stream " << params.name << ": building tables for angles = " << angles << " rings = " << rings << " overlap = " << ovl << endl;
+
+    LogPolarTables *t = cache->acquire(getMode(), rings, angles, width, height, ovl);
+    if (t == 0) {
+        cerr << "can't allocate lookup tables" << endl;
+        return;
+    }
+
+    // a build not swapped in yet is superseded by the newer one. Builds of the same stream
+    // might run concurrently, a build of a geometry changed in the meantime is dropped
+    // (the build of the newer geometry is queued).
+    mutex.wait();
+    if (angles != requestedAngles || rings != requestedRings || ovl != requestedOverlap) {
+        mutex.post();
+        cache->release(t);
+        return;
+    }
+    LogPolarTables *old = next;
+    next = t;
+    nextAngles = angles;
+    nextRings = rings;
+    nextOverlap = ovl;
+    mutex.post();
+
+    cache->release(old);
+}
+
+void LogPolarTransformThread::swapTables() {
+    //
+    mutex.wait();
+    LogPolarTables *old = 0;
+    if (next != 0) {
+        old = tables;
+        tables = next;
+        params.numberOfAngles = nextAngles;
+        params.numberOfRings = nextRings;
+        params.overlap = nextOverlap;
+        next = 0;
+    }
+    mutex.post();
+
+    cache->release(old);
+}
+
+void LogPolarTransformThread::releasePipeline() {
+    //
+    if (writer) {
+        writer->stop();
+        delete writer;
+        writer = 0;
+    }
+
+    if (freeFrames) delete freeFrames;
+    if (doneFrames) delete doneFrames;
+    freeFrames = doneFrames = 0;
+
+    if (frames) {
+        // frames dropped while stopping still hold their tables.
+        for (int i = 0; i < nFrames; i++)
+            cache->release(frames[i].tables);
+        delete[] frames;
+    }
+    frames = 0;
+
+    cache->release(tables);
+    cache->release(next);
+    tables = next = 0;
+}
+
+void LogPolarTransformThread::threadRelease() {
+    /* the frames and the tables might still be in use by the pool, they're released by the destructor */
+    if (writer) writer->stop();
+
+    imagePortOut.interrupt();
+    cartPortOut.interrupt();
+    psnrPortOut.interrupt();
+}
+
+double LogPolarTransformThread::computePSNR(const ImageOf<PixelRgb>& a, const ImageOf<PixelRgb>& b) {
+    //
+    const int width = (a.width() < b.width()) ? a.width() : b.width();
+    const int height = (a.height() < b.height()) ? a.height() : b.height();
+
+    // the retina is the disk inscribed in the cartesian image, pixels outside are not reconstructed.
+    const double cx = width / 2.0;
+    const double cy = height / 2.0;
+    const double radius = ((width < height) ? width : height) / 2.0;
+    const double radius2 = radius * radius;
+
+    double sse = 0.;
+    int count = 0;
+    for (int i = 0; i < height; i++) {
+        const double dy = i + 0.5 - cy;
+        const unsigned char *pa = a.getRow(i);
+        const unsigned char *pb = b.getRow(i);
+        for (int j = 0; j < width; j++, pa+=3, pb+=3) {
+            const double dx = j + 0.5 - cx;
+            if (dx * dx + dy * dy >= radius2)
+                continue;
+
+            for (int k = 0; k < 3; k++) {
+                const double d = (double)pa[k] - (double)pb[k];
+                sse += d * d;
+            }
+            count += 3;
+        }
+    }
+
+    if (count == 0 || sse == 0.)
+        return 100.0;   // identical images, report a conventional upper bound.
+
+    const double mse = sse / count;
+    return 10.0 * log10(255.0 * 255.0 / mse);
 }
 
 
@@ -61,8 +61,18 @@
  *   specifies the input port name (this string will be prefixed by \c /LogPolarTransform
  *   or whatever else is specifed by the name parameter
  *
+ * - \c cartOutputPort \c /cart:o \n    
+ *   specifies the reconstructed cartesian output port name, only opened in BIDIRECTIONAL mode 
+ *   (this string will be prefixed by \c /LogPolarTransform or whatever else is specifed by the name parameter
+ *
+ * - \c psnrOutputPort \c /psnr:o \n    
+ *   specifies the round-trip PSNR output port name, only opened in BIDIRECTIONAL mode 
+ *   (this string will be prefixed by \c /LogPolarTransform or whatever else is specifed by the name parameter
+ *
  * - \c direction \c CARTESIAN2LOGPOLAR \n
- *   specifies the direction of the tranform; the alternative direction is LOGPOLAR2CARTESIAN
+ *   specifies the direction of the tranform; the alternative directions are LOGPOLAR2CARTESIAN and 
+ *   BIDIRECTIONAL. The latter maps the input to logpolar and reconstructs the cartesian image from 
+ *   the same logpolar buffer, streaming both
  *   
  * - \c angles \c 252  \n           
  *   specifies the number of receptive fields per ring (i.e. the number of samples in the theta/angular dimension); 
@@ -83,6 +93,32 @@
  * - \c overlap \c 1.0     \n        
  *   specifies the relative overlap of each receptive field
  *
+ * - \c frames \c 4     \n        
+ *   specifies the number of frames in flight between the reading, transform and writing stages
+ *   of a stream (at least 3); output frames keep the order and time stamps of the input
+ *
+ * - \c workers \c 0     \n        
+ *   specifies the number of threads running the transform, shared by all the streams; 
+ *   0 stands for one thread per core. Reading the input port and writing the output ports 
+ *   run concurrently on two additional threads per stream
+ *
+ * - \c pages \c default     \n        
+ *   specifies where the lookup tables are allocated: \c default (heap), \c transparent 
+ *   (transparent huge pages) or \c huge (reserved huge pages, transparent ones if none is 
+ *   available); huge pages cut the TLB misses of the large geometries (Linux only)
+ *
+ * - \c numa     \n        
+ *   if present, the logpolar tables are replicated on each NUMA node of the host and the
+ *   workers read the copy local to the node they run on
+ *
+ * - \c streams \c (left \c right)     \n        
+ *   optional list of streams served by the module. The parameters of each stream are read
+ *   from the group of the same name (e.g. \c [left]) and default to the parameters above;
+ *   the port names of a stream are prefixed by its name, e.g. \c /logpolarTransform/left/image:i.
+ *   Streams with the same geometry share the lookup tables. Without the list the module serves 
+ *   a single stream configured by the parameters above. Each stream starts serving with coarse
+ *   (nearest neighbour) tables, the exact ones replace them between two frames as soon as they are built
+ *
  * 
  * \section portsa_sec Ports Accessed
  * 
@@ -98,6 +134,12 @@
  * 
  *  -  help \n
  *  -  quit \n
+ *  -  set angles N [stream] \n
+ *  -  set rings N [stream] \n
+ *  -  set overlap X [stream] \n
+ *     change the geometry of the mapping of the named stream, or of all the streams if the name is 
+ *     omitted. The new tables are built in background and replace the current ones between two frames, 
+ *     the output stream is not interrupted
  *  
  *    Note that the name of this port mirrors whatever is provided by the \c  --name \c parameter \c value
  *    The port is attached to the terminal so that you can type in commands and receive replies.
@@ -106,6 +148,8 @@
  *       
  *  - /logpolarTransform/image:i
  *
+ *  Ports are prefixed by the stream name when the \c streams list is given (e.g. \c /logpolarTransform/left/image:i).
+ *
  * <b>Output ports</b>
  *
  *  - \c /logpolarTransform
@@ -113,6 +157,13 @@
  *
  *  - \c /logpolarTransform/image:o
  *
+ *  - \c /logpolarTransform/cart:o \n
+ *    the cartesian reconstruction of the logpolar image (BIDIRECTIONAL mode only)
+ *
+ *  - \c /logpolarTransform/psnr:o \n
+ *    the round-trip PSNR (dB) between the input and the reconstructed image, computed 
+ *    within the retina disk (BIDIRECTIONAL mode only)
+ *
  * <b>Port types </b>
  *
  * The functional specification only names the ports to be used to communicate with the module 
@@ -120,6 +171,8 @@
  *
  * - \c BufferedPort<ImageOf<PixelRgb> >   \c imageInputPort;     
  * - \c BufferedPort<ImageOf<PixelRgb> >   \c imageOutputPort;       
+ * - \c BufferedPort<ImageOf<PixelRgb> >   \c cartOutputPort;       
+ * - \c BufferedPort<Bottle>               \c psnrOutputPort;       
  *
  * \section in_files_sec Input Data Files
  *
@@ -183,45 +236,154 @@
 /* Log-Polar includes */
 #include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
 
+#include "logPolarPipeline.h"
+
+enum {
+    CARTESIAN2LOGPOLAR = 0,
+    LOGPOLAR2CARTESIAN = 1,
+    BIDIRECTIONAL = 2
+};
+
+/**
+ * the configuration of a stream: port names and geometry of the mapping.
+ */
+struct LogPolarStreamParameters
+{
+    std::string name;                // stream name (empty for the single stream configuration)
+    std::string inputPortName;
+    std::string outputPortName;
+    std::string cartOutputPortName;
+    std::string psnrOutputPortName;
+    int    direction;                // direction of transform
+    int    numberOfAngles;           // theta samples
+    int    numberOfRings;            // r samples
+    int    xSize;                    // x samples
+    int    ySize;                    // y samples
+    double overlap;                  // overlap of receptive fields
+    int    frames;                   // number of frames in flight in the pipeline
+};
 
+/**
+ * a stream of the module: reads its input port, hands the frames to the shared 
+ * worker pool and writes the results in order on its output ports.
+ */
 class LogPolarTransformThread : public yarp::os::Thread
 {
 private:
-    /* thread parameters: they are pointers so that they refer to the original variables in LogPolarTransform */
-    yarp::os::BufferedPort<yarp::sig::FlexImage> *imagePortIn;
-    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *imagePortOut;   
-    yarp::sig::ImageOf<yarp::sig::PixelRgb> *inputImage;
+    LogPolarStreamParameters params;
+
+    yarp::os::BufferedPort<yarp::sig::FlexImage> imagePortIn;
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > imagePortOut;   
+    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > cartPortOut;   
+    yarp::os::BufferedPort<yarp::os::Bottle> psnrPortOut;   
+
+    LogPolarWorkerPool *pool;
+    LogPolarTableCache *cache;
+    LogPolarTableBuilder *builder;
+    LogPolarTables *tables;                     // owned by the cache, possibly shared with other streams
+
+    /* run time reconfiguration: the geometry requested and the tables built for it, swapped in by the reader */
+    yarp::os::Semaphore mutex;
+    bool initialized;
+    bool rebuildQueued;
+    int requestedAngles;
+    int requestedRings;
+    double requestedOverlap;
+    LogPolarTables *next;
+    int nextAngles;
+    int nextRings;
+    double nextOverlap;
 
-    int *directionValue;     
-    int *anglesValue;     
-    int *ringsValue;   
-    int *xSizeValue;
-    int *ySizeValue;
-    double *overlapValue;     
+    int getMode() const;
+    void swapTables();
 
-    iCub::logpolar::logpolarTransform trsf;
+    /* the pipeline: this thread reads the input port, the pool transforms and the writer sends the results out */
+    LogPolarFrame *frames;
+    int nFrames;
+    int sequence;
+    LogPolarFrameQueue *freeFrames;
+    LogPolarFrameQueue *doneFrames;
+    LogPolarOutputWriter *writer;
+
+    void releasePipeline();
 
 public:
-    LogPolarTransformThread(yarp::os::BufferedPort<yarp::sig::FlexImage > *imageIn,  yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *imageOut, 
-                            int *direction, int *x, int *y, int *angles, int  *rings, double *overlap);
+    LogPolarTransformThread(const LogPolarStreamParameters& p, LogPolarWorkerPool *workers, LogPolarTableCache *tables, LogPolarTableBuilder *tableBuilder);
+    ~LogPolarTransformThread();
+
+    /**
+     * open the ports of the stream.
+     * @return true iff successful.
+     */
+    bool open();
+
+    /**
+     * close the ports of the stream (the thread must have been stopped).
+     */
+    void close();
+
     bool threadInit();     
     void threadRelease();
     void run(); 
+    void onStop();
 
-    bool allocLookupTables(int which, int necc, int nang, int w, int h, double overlap);
-    bool freeLookupTables();
+    /**
+     * get the name of the stream.
+     * @return the name of the stream.
+     */
+    const std::string& getStreamName() const { return params.name; }
 
-    virtual void onStop() {
-        imagePortIn->interrupt();
-        imagePortOut->interrupt();
-        imagePortIn->close();
-        imagePortOut->close();
-    }
-};
+    /**
+     * get the geometry of the mapping (the last one requested).
+     * @param angles is the number of angles.
+     * @param rings is the number of rings.
+     * @param overlap is the overlap of the receptive fields.
+     */
+    void getGeometry(int& angles, int& rings, double& overlap);
 
-enum {
-    CARTESIAN2LOGPOLAR = 0,
-    LOGPOLAR2CARTESIAN = 1
+    /**
+     * change the geometry of the mapping at run time. The new tables are built in background
+     * while the current ones keep serving, and are swapped in between two frames.
+     * @param angles is the number of angles.
+     * @param rings is the number of rings.
+     * @param overlap is the overlap of the receptive fields.
+     * @return false if the geometry is not valid.
+     */
+    bool setGeometry(int angles, int rings, double overlap);
+
+    /**
+     * build the tables for the geometry requested (called by the table builder).
+     */
+    void rebuild();
+
+    /**
+     * transform a frame according to the direction of the mapping (transform stage).
+     * This is called concurrently by the workers of the pool.
+     * @param frame is the frame to be transformed.
+     */
+    void process(LogPolarFrame *frame);
+
+    /**
+     * hand a transformed frame back to the stream for writing.
+     * @param frame is the frame.
+     * @return false if the stream is stopping.
+     */
+    bool complete(LogPolarFrame *frame) { return doneFrames->put(frame); }
+
+    /**
+     * write a transformed frame to the output ports, with the envelope of the input image (output stage).
+     * @param frame is the frame to be written.
+     */
+    void emit(LogPolarFrame *frame);
+
+    /**
+     * compute the peak signal to noise ratio between two cartesian images of the same size, 
+     * restricted to the disk inscribed in the image (i.e. the area covered by the retina).
+     * @param a is the first image (e.g. the original).
+     * @param b is the second image (e.g. the reconstruction).
+     * @return the PSNR in dB.
+     */
+    double computePSNR(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& a, const yarp::sig::ImageOf<yarp::sig::PixelRgb>& b);
 };
 
 class LogPolarTransform : public yarp::os::RFModule
@@ -229,28 +391,28 @@ class LogPolarTransform : public yarp::os::RFModule
     //int debug;
 
     std::string moduleName;
-    std::string robotPortName;  
-    std::string inputPortName;
-    std::string outputPortName;  
     std::string handlerPortName;
-    std::string transformDirection;
-    int    direction;                // direction of transform
-    int    numberOfAngles;           // theta samples
-    int    numberOfRings;            // r samples
-    int    xSize;                    // x samples
-    int    ySize;                    // y samples
-    double  overlap;                 // overlap of receptive fields
+    int    workers;                  // number of transform workers shared by the streams
+    int    pages;                    // where the lookup tables are allocated
+    bool   numa;                     // whether the lookup tables are replicated per NUMA node
 
     /* class variables */
 
-    yarp::os::BufferedPort<yarp::sig::FlexImage> imageIn;      // input port
-    yarp::os::BufferedPort<yarp::sig::ImageOf<yarp::sig::PixelRgb> > imageOut;     // output port
     yarp::os::Port handlerPort;                              //a port to handle messages 
 
-    /* pointer to a new thread to be created and started in configure() and stopped in close() */
-    LogPolarTransformThread *logPolarTransformThread;
+    LogPolarWorkerPool pool;
+    LogPolarTableCache cache;
+    LogPolarTableBuilder builder;
+
+    /* the streams, created and started in configure() and stopped in close() */
+    LogPolarTransformThread **streams;
+    int nStreams;
+
+    bool readStreamParameters(yarp::os::ResourceFinder &rf, const std::string& stream, LogPolarStreamParameters& p);
 
 public:
+    LogPolarTransform() : streams(0), nStreams(0) {}
+
     bool configure(yarp::os::ResourceFinder &rf); // configure all the module parameters and return true if successful
     bool interruptModule();                       // interrupt, e.g., the ports 
     bool close();                                 // close and shut down the module
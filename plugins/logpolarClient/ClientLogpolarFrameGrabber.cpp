@@ -27,12 +27,33 @@
 using namespace yarp::os;
 using namespace yarp::dev;
 using namespace yarp::sig;
+using namespace iCub::logpolar;
+
+/*
+ * the remap of a logpolar image to cartesian, split in stripes of rows.
+ */
+class ReconstructionJob : public StripeJob {
+public:
+    logpolarTransform *trsf;
+    ImageOf<PixelRgb> *cart;
+    const ImageOf<PixelRgb> *lp;
+
+    ReconstructionJob(logpolarTransform *t, ImageOf<PixelRgb> *c, const ImageOf<PixelRgb> *l) : trsf(t), cart(c), lp(l) {}
+
+    virtual void processStripe(int stripe, int stripes) {
+        int first, last;
+        getStripe(trsf->height(), stripe, stripes, first, last);
+        trsf->logpolarToCart(*cart, *lp, first, last);
+    }
+};
 
 /*
  * implementation of the ClientLogpolarFrameGrabber class.
  */
 
-ClientLogpolarFrameGrabber::ClientLogpolarFrameGrabber() : RemoteFrameGrabberDC1394(), nmutex(1) {}
+ClientLogpolarFrameGrabber::ClientLogpolarFrameGrabber() : RemoteFrameGrabberDC1394(), nmutex(1),
+    lenderLogpolar(&readerLogpolar, &nmutex), lenderFoveal(&readerFoveal, &nmutex), 
+    bundle(false), bmutex(1), geometryValid(false), geometryFetched(false), gmutex(1), rworkers(0), rmutex(1) {}
 
 bool ClientLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     nmutex.wait();
@@ -67,11 +88,46 @@ bool ClientLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
          }
     }
     
+    // the combined stream is optional and read on its own.
+    bmutex.wait();
+    bundle = config.check("bundle", "if present, receive the combined stream too");
+    if (bundle) {
+        ConstString loc3 = local + "/bundle";
+        portBundle.open(loc3);
+        if (remote != "") {
+            yarp::os::ConstString carrier = 
+                config.check("stream",yarp::os::Value("tcp"),
+                             "carrier to use for streaming").asString();
+            if (!Network::connect(remote + "/bundle", loc3, carrier)) {
+                fprintf(stderr, "ClientLogpolarFrameGrabber: can't connect to the combined stream of the server\n");
+                portBundle.close();
+                bundle = false;
+            }
+        }
+    }
+    bmutex.post();
+
     // attach the readers.
     readerLogpolar.attach(portLogpolar);
     readerFoveal.attach(portFoveal);
 
     nmutex.post();
+
+    rmutex.wait();
+    if (rworkers == 0) {
+        const int nthreads = config.check("reconstruction_threads", Value(2), "number of threads remapping to cartesian").asInt();
+        rworkers = new StripeWorkers(nthreads);
+    }
+    rmutex.post();
+
+    // the geometry doesn't change (unless the server says so), ask only once.
+    gmutex.wait();
+    geometryValid = false;
+    geometryFetched = false;
+    if (remote != "")
+        fetchGeometry();
+    gmutex.post();
+
     return true;
 }
 
@@ -80,9 +136,168 @@ bool ClientLogpolarFrameGrabber::close() {
     portLogpolar.close();
     portFoveal.close();
     nmutex.post();
+
+    bmutex.wait();
+    if (bundle) portBundle.close();
+    bundle = false;
+    bmutex.post();
+
+    rmutex.wait();
+    freeReconstructionTables();
+    if (rworkers) delete rworkers;
+    rworkers = 0;
+    rmutex.post();
+
     return RemoteFrameGrabberDC1394::close();
 }
 
+bool ClientLogpolarFrameGrabber::fetchGeometry() {
+    Bottle cmd, response;
+    cmd.addVocab(VOCAB_GET);
+    cmd.addVocab(VOCAB_GEOMETRY);
+
+    // the RPC port is shared with the requests of the base class, a reply mustn't be
+    // picked up by another request: the write is serialized on the grabber semaphore.
+    mutex.wait();
+    port.write(cmd, response);
+    mutex.post();
+
+    // [is] [geom] necc nang fovea overlap width height
+    if (response.size() >= 8 && response.get(1).asVocab() == VOCAB_GEOMETRY) {
+        geometry.necc = response.get(2).asInt();
+        geometry.nang = response.get(3).asInt();
+        geometry.fovea = response.get(4).asInt();
+        geometry.overlap = response.get(5).asDouble();
+        geometry.width = response.get(6).asInt();
+        geometry.height = response.get(7).asInt();
+    }
+    else {
+        // an older server, one request per parameter.
+        geometry.necc = (int)getCommand(VOCAB_NECC);
+        geometry.nang = (int)getCommand(VOCAB_NANG);
+        geometry.fovea = (int)getCommand(VOCAB_FOVEA);
+        geometry.overlap = getCommand(VOCAB_OVERLAP);
+        geometry.width = 0;
+        geometry.height = 0;
+    }
+
+    // asked, whatever the answer: a server that doesn't answer isn't asked again at every call.
+    geometryFetched = true;
+    geometryValid = (geometry.necc != 0 && geometry.nang != 0);
+    return geometryValid;
+}
+
+LogpolarGeometry ClientLogpolarFrameGrabber::cachedGeometry() const {
+    ClientLogpolarFrameGrabber *self = (ClientLogpolarFrameGrabber *)this;
+    self->gmutex.wait();
+    if (!geometryFetched)
+        self->fetchGeometry();
+    const LogpolarGeometry g = geometry;
+    self->gmutex.post();
+    return g;
+}
+
+void ClientLogpolarFrameGrabber::checkGeometry(const ImageOf<PixelRgb>& image) {
+    gmutex.wait();
+    // a geometry that couldn't be fetched (all zeros) never matches, thus it is asked
+    // again at most once per received image.
+    if (geometryFetched && (image.width() != geometry.nang || image.height() != geometry.necc)) {
+        geometryValid = false;
+        geometryFetched = false;
+    }
+    gmutex.post();
+}
+
+logpolarTransform *ClientLogpolarFrameGrabber::getReconstructionTables(const LogpolarGeometry& g, int w, int h) {
+    // tables built for a different geometry are of no use any longer.
+    if (g.necc != rgeometry.necc || g.nang != rgeometry.nang || g.overlap != rgeometry.overlap) {
+        freeReconstructionTables();
+        rgeometry = g;
+    }
+
+    const std::pair<int, int> size(w, h);
+    ReconstructionTables::iterator it = reconstructions.find(size);
+    if (it != reconstructions.end())
+        return it->second;
+
+    logpolarTransform *trsf = new logpolarTransform;
+    if (!trsf->allocLookupTables(L2C, g.necc, g.nang, w, h, g.overlap)) {
+        fprintf(stderr, "ClientLogpolarFrameGrabber: can't build the tables for a %dx%d reconstruction\n", w, h);
+        delete trsf;
+        return 0;
+    }
+
+    reconstructions[size] = trsf;
+    return trsf;
+}
+
+void ClientLogpolarFrameGrabber::freeReconstructionTables() {
+    ReconstructionTables::iterator it;
+    for (it = reconstructions.begin(); it != reconstructions.end(); it++)
+        delete it->second;
+    reconstructions.clear();
+}
+
+bool ClientLogpolarFrameGrabber::getCartesianReconstruction(ImageOf<PixelRgb>& image, int w, int h) {
+    LogpolarImageView view;
+    if (!borrowLogpolarImage(view))
+        return false;
+
+    // a new geometry has been fetched by now if the image doesn't match the old one.
+    const LogpolarGeometry g = cachedGeometry();
+    const ImageOf<PixelRgb>& lp = view.image();
+    if (lp.width() != g.nang || lp.height() != g.necc)
+        return false;
+
+    if (w <= 0) w = (g.width > 0) ? g.width : 640;
+    if (h <= 0) h = (g.height > 0) ? g.height : 480;
+
+    rmutex.wait();
+    logpolarTransform *trsf = (rworkers != 0) ? getReconstructionTables(g, w, h) : 0;
+    if (trsf == 0) {
+        rmutex.post();
+        return false;
+    }
+
+    image.resize(w, h);
+    ReconstructionJob job(trsf, &image, &lp);
+    rworkers->run(job);
+    rmutex.post();
+
+    return true;
+}
+
+bool ClientLogpolarFrameGrabber::getLogpolarBundle(ImageOf<PixelRgb>& lp, ImageOf<PixelRgb>& fovea, Stamp& stamp) {
+    bmutex.wait();
+    LogpolarBundle *datum = bundle ? portBundle.read(true) : 0;
+    if (datum == NULL) {
+        bmutex.post();
+        return false;
+    }
+
+    lp = datum->body.head;
+    fovea = datum->body.body;
+    portBundle.getEnvelope(stamp);
+
+    // necc nang fovea overlap width height.
+    const Bottle& g = datum->head;
+    if (g.size() >= 6) {
+        gmutex.wait();
+        geometry.necc = g.get(0).asInt();
+        geometry.nang = g.get(1).asInt();
+        geometry.fovea = g.get(2).asInt();
+        geometry.overlap = g.get(3).asDouble();
+        geometry.width = g.get(4).asInt();
+        geometry.height = g.get(5).asInt();
+        geometryFetched = true;
+        geometryValid = (geometry.necc != 0 && geometry.nang != 0);
+        gmutex.post();
+    }
+    bmutex.post();
+
+    return true;
+}
+
 /**
  * @endcond
  */
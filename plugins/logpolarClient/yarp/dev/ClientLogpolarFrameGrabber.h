@@ -18,22 +18,76 @@
 #ifndef _YARP2_CLIENTLOGPOLARFRAMEGRABBER_
 #define _YARP2_CLIENTLOGPOLARFRAMEGRABBER_
 
+#include <map>
+#include <utility>
+
 #include <yarp/os/Network.h>
 #include <yarp/os/Semaphore.h>
+#include <yarp/os/BufferedPort.h>
 #include <yarp/dev/ServerFrameGrabber.h>
 #include <yarp/dev/RemoteFrameGrabber.h>
 
 #include <iCub/logpolar/LogpolarInterfaces.h>
 #include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+#include <iCub/logpolar/StripeWorkers.h>
 
 namespace yarp{
     namespace dev {
         class ClientLogpolarFrameGrabber;
+        template <class T> class PortReaderLender;
     }
 }
 
 #define NSEMA ((yarp::os::Semaphore&)nmutex)
 
+/**
+ * @ingroup logpolar
+ *
+ * Lend the buffers of a PortReaderBuffer: an acquired buffer is not reused by the 
+ * reader until it is released.
+ */
+template <class T>
+class yarp::dev::PortReaderLender : public yarp::dev::ILogpolarImageLender {
+private:
+    yarp::os::PortReaderBuffer<T> *reader;
+    yarp::os::Semaphore *mutex;
+
+public:
+    /**
+     * Constructor.
+     * @param r is the reader owning the buffers.
+     * @param m is the mutex protecting the reader.
+     */
+    PortReaderLender(yarp::os::PortReaderBuffer<T> *r, yarp::os::Semaphore *m) : reader(r), mutex(m) {}
+
+    /**
+     * Read the next object and lend it.
+     * @param view refers to the object on return.
+     * @return true iff successful.
+     */
+    bool borrow(LogpolarImageView& view) {
+        mutex->wait();
+        T *datum = reader->read(true);
+        if (datum == NULL) {
+            mutex->post();
+            return false;
+        }
+        void *key = reader->acquire();
+        mutex->post();
+        view.attach(this, key, datum);
+        return true;
+    }
+
+    /**
+     * Give a buffer back to the reader. This doesn't wait for a pending read, 
+     * the reader synchronizes the access to its own pool of buffers.
+     * @param key identifies the buffer.
+     */
+    virtual void releaseImage(void *key) {
+        reader->release(key);
+    }
+};
+
 /**
  * @ingroup logpolar
  *
@@ -45,6 +99,10 @@ namespace yarp{
  */
 class yarp::dev::ClientLogpolarFrameGrabber : 
                                 public yarp::dev::ILogpolarFrameGrabberImage,
+                                public yarp::dev::ILogpolarImageBorrow,
+                                public yarp::dev::ILogpolarGeometry,
+                                public yarp::dev::ILogpolarReconstruction,
+                                public yarp::dev::ILogpolarBundle,
                                 public yarp::dev::RemoteFrameGrabberDC1394 {
 private:
     ClientLogpolarFrameGrabber(const ClientLogpolarFrameGrabber&);
@@ -56,6 +114,65 @@ protected:
     yarp::os::PortReaderBuffer<yarp::sig::ImageOf<yarp::sig::PixelRgb> > readerLogpolar;
     yarp::os::PortReaderBuffer<yarp::sig::ImageOf<yarp::sig::PixelRgb> > readerFoveal;
     yarp::os::Semaphore nmutex;
+    PortReaderLender<yarp::sig::ImageOf<yarp::sig::PixelRgb> > lenderLogpolar;
+    PortReaderLender<yarp::sig::ImageOf<yarp::sig::PixelRgb> > lenderFoveal;
+
+    // the optional combined stream (logpolar, fovea and geometry in one message).
+    yarp::os::BufferedPort<LogpolarBundle> portBundle;
+    bool bundle;
+    yarp::os::Semaphore bmutex;
+
+    // the geometry is fetched once from the server and cached, it has its own 
+    // mutex so that the getters don't wait for the image reads. geometryFetched
+    // records that the server was asked (even if it didn't answer), it is cleared
+    // only when a received image doesn't match the geometry.
+    LogpolarGeometry geometry;
+    bool geometryValid;
+    bool geometryFetched;
+    yarp::os::Semaphore gmutex;
+
+    // the tables of the cartesian reconstruction, one set per requested size, are
+    // built on first use for the geometry in rgeometry.
+    typedef std::map<std::pair<int, int>, iCub::logpolar::logpolarTransform *> ReconstructionTables;
+    ReconstructionTables reconstructions;
+    LogpolarGeometry rgeometry;
+    iCub::logpolar::StripeWorkers *rworkers;
+    yarp::os::Semaphore rmutex;
+
+    /**
+     * Get the geometry from the server (a single request, or one per parameter with older servers).
+     * @return true iff successful.
+     */
+    bool fetchGeometry();
+
+    /**
+     * Get the cached geometry, fetching it if it hasn't been asked for yet (a failed
+     * fetch isn't retried on every call, only after checkGeometry() sees a mismatch).
+     * @return a copy of the geometry.
+     */
+    LogpolarGeometry cachedGeometry() const;
+
+    /**
+     * Invalidate the cached geometry if a received logpolar image doesn't match it
+     * (the server has changed the geometry, or it couldn't be fetched), the next
+     * cachedGeometry() asks the server again.
+     * @param image is the received logpolar image.
+     */
+    void checkGeometry(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& image);
+
+    /**
+     * Get the L2C tables for a given size, building them if needed (rmutex must be held).
+     * @param g is the geometry of the logpolar image to remap.
+     * @param w is the width of the cartesian image.
+     * @param h is the height of the cartesian image.
+     * @return the tables or 0 in case of failure.
+     */
+    iCub::logpolar::logpolarTransform *getReconstructionTables(const LogpolarGeometry& g, int w, int h);
+
+    /**
+     * Free all the tables of the cartesian reconstruction (rmutex must be held).
+     */
+    void freeReconstructionTables();
 
 public:
     /**
@@ -76,7 +193,10 @@ public:
      * <TR><TD> local </TD><TD> Port name of this client. </TD></TR>
      * <TR><TD> remote </TD><TD> Port name of server to connect to. </TD></TR>
      * <TR><TD> stream </TD><TD> Carrier for the stream connection. </TD></TR>
+     * <TR><TD> reconstruction_threads </TD><TD> Number of threads remapping to cartesian (default 2). </TD></TR>
+     * <TR><TD> bundle </TD><TD> If present, also receive the combined stream of the server (remote/bundle). </TD></TR>
      * </TABLE>
+     * The geometry of the logpolar images is fetched from the server here and cached.
      *
      * @param config The options to use
      * @return true iff the object could be configured.
@@ -95,10 +215,7 @@ public:
      * @return the number of eccentricities of the logpolar image.
      */
     virtual int necc(void) const {
-        NSEMA.wait();
-        const int i = (int)getCommand(VOCAB_NECC);
-        NSEMA.post();
-        return i;
+        return cachedGeometry().necc;
     }
 
     /**
@@ -106,10 +223,7 @@ public:
      * @return the number of angles of the logpolar image.
      */
     virtual int nang(void) const {
-        NSEMA.wait();
-        const int i = (int)getCommand(VOCAB_NANG);
-        NSEMA.post();
-        return i;
+        return cachedGeometry().nang;
     }
 
     /**
@@ -117,10 +231,7 @@ public:
      * @return the size of the foveal image (square).
      */
     virtual int fovea(void) const {
-        NSEMA.wait();
-        const int i = (int)getCommand(VOCAB_FOVEA);
-        NSEMA.post();
-        return i;
+        return cachedGeometry().fovea;
     }
 
     /**
@@ -128,10 +239,18 @@ public:
      * @return the size of the overlap (double).
      */
     virtual double overlap(void) const {
-        NSEMA.wait();
-        const double x = getCommand(VOCAB_OVERLAP);
-        NSEMA.post();
-        return x;
+        return cachedGeometry().overlap;
+    }
+
+    // implement ILogpolarGeometry.
+    /**
+     * Get the whole geometry of the logpolar images, cached at open.
+     * @param g is filled with the geometry.
+     * @return true iff successful.
+     */
+    virtual bool getGeometry(LogpolarGeometry& g) {
+        g = cachedGeometry();
+        return (g.necc != 0 && g.nang != 0);
     }
 
     /**
@@ -144,6 +263,7 @@ public:
         if (readerLogpolar.read(true) != NULL) {
             image = *(readerLogpolar.lastRead());
             nmutex.post();
+            checkGeometry(image);
             return true;
         }
         nmutex.post();
@@ -165,6 +285,56 @@ public:
         nmutex.post();
         return false;
     }
+
+    // implement ILogpolarImageBorrow.
+    /**
+     * Borrow the next logpolar image straight from the receive buffer of the port (no copy).
+     * The buffer is given back to the port when the view is dropped.
+     * @param view refers to the logpolar image on return.
+     * @return true iff successful.
+     */
+    virtual bool borrowLogpolarImage(LogpolarImageView& view) {
+        if (!lenderLogpolar.borrow(view))
+            return false;
+        checkGeometry(view.image());
+        return true;
+    }
+
+    /**
+     * Borrow the next foveal image straight from the receive buffer of the port (no copy).
+     * The buffer is given back to the port when the view is dropped.
+     * @param view refers to the foveal image on return.
+     * @return true iff successful.
+     */
+    virtual bool borrowFovealImage(LogpolarImageView& view) {
+        return lenderFoveal.borrow(view);
+    }
+
+    // implement ILogpolarReconstruction.
+    /**
+     * Get the next logpolar image remapped to cartesian. The image is remapped straight
+     * from the receive buffer of the port, the tables for each size are built on the
+     * first request and kept until the geometry changes or the device is closed.
+     * @param image is the reconstructed RGB image, resized to w by h.
+     * @param w is the width of the reconstruction, zero or negative for the width of the sensor.
+     * @param h is the height of the reconstruction, zero or negative for the height of the sensor.
+     * @return true iff successful.
+     */
+    virtual bool getCartesianReconstruction(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image, int w = 0, int h = 0);
+
+    // implement ILogpolarBundle.
+    /**
+     * Get the next logpolar image and the fovea of the same frame from the combined stream, 
+     * with a single read. The geometry sent along refreshes the cached one. Available only
+     * if the device is opened with the bundle option.
+     * @param lp is the RGB image containing the logpolar subsampled image.
+     * @param fovea is the RGB image containing the foveal image.
+     * @param stamp is the time stamp of the frame.
+     * @return true iff successful.
+     */
+    virtual bool getLogpolarBundle(yarp::sig::ImageOf<yarp::sig::PixelRgb>& lp, 
+                                   yarp::sig::ImageOf<yarp::sig::PixelRgb>& fovea, 
+                                   yarp::os::Stamp& stamp);
 };
 
 #undef NSEMA
@@ -18,6 +18,7 @@
 
 #include <memory.h>
 #include <cstdio>
+#include <cmath>
 #include <string>
 
 #include <yarp/dev/PolyDriver.h>
@@ -30,21 +31,26 @@ using namespace yarp::dev;
 using namespace yarp::sig;
 
 /* 
- * acquisition size, fixed to the reasonable maximum available at the moment. 
+ * default acquisition size, the reasonable maximum available at the moment. 
  */
 const int baseWidth = 640;
 const int baseHeight = 480;
 
 /* 
- * size of the logpolar image, resembling one of the cmos sensors developed
- * at LIRA-Lab. These are not meant to be parameters of the driver although the code
- * is pretty generic anyway.
+ * default size of the logpolar image, resembling one of the cmos sensors developed
+ * at LIRA-Lab. 
  */
 const int nEcc = 152;   // number of rows (multiple of 6 for the foveal arrangement).
 const int nAng = 252;   // number of columns (same as above).
 const int nFovea = 128; // size of the fovea.
 const double baseOverlap = 1.0;
 
+/*
+ * number of buffers in the ring: one per formatter thread (including the bundle), one for 
+ * the direct calls to the get methods, plus the latest image and the one being acquired.
+ */
+const int ringSize = 4 + 1 + 2;
+
 /* 
  * Constructor. 
  */ 
@@ -64,6 +70,11 @@ ServerLogpolarFrameGrabber::ServerLogpolarFrameGrabber() : RateThread(0), mutex(
     inecc = 0;
     ifovea = 0;
     ioverlap = 0.;
+    bwidth = 0;
+    bheight = 0;
+
+    stdWorkers = 0;
+    bundle = false;
 }
 
 /* 
@@ -84,11 +95,15 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     cwidth = config.check("width", Value(baseWidth), "the width of the output rectangular image").asInt();
     cheight = config.check("height", Value(baseHeight), "the height of the output rectangular image").asInt();
 
-    // size of the logp output. Use the member var from now on (LATER: make these driver params).
-    inecc = nEcc;
-    inang = nAng;
-    ifovea = nFovea;
-    ioverlap = baseOverlap;
+    // size of the logp output. Use the member var from now on.
+    inecc = config.check("necc", Value(nEcc), "the number of eccentricities of the logpolar image").asInt();
+    inang = config.check("nang", Value(nAng), "the number of angles of the logpolar image").asInt();
+    ifovea = config.check("fovea", Value(nFovea), "the size of the foveal image").asInt();
+    ioverlap = config.check("overlap", Value(baseOverlap), "the overlap of the receptive fields").asDouble();
+
+    // the resolution requested to the subdevice.
+    const int swidth = config.check("sensor_width", Value(baseWidth), "the width requested to the subdevice").asInt();
+    const int sheight = config.check("sensor_height", Value(baseHeight), "the height requested to the subdevice").asInt();
 
     yarp::os::Value *name;
 
@@ -104,8 +119,8 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
             p.fromString(config.toString());
             p.put("device", name->toString());
             // forces the subdevice to go maximum resolution (assuming this is the max!).
-            p.put("width", baseWidth);
-            p.put("height", baseHeight);
+            p.put("width", swidth);
+            p.put("height", sheight);
             p.unput("subdevice");
             poly.open(p);
         } else {
@@ -136,8 +151,25 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
         }
     }
 
-    // the main image buffer.
-    buffer.resize(fgImage->width(), fgImage->height());
+    // the image buffers.
+    bwidth = fgImage->width();
+    bheight = fgImage->height();
+    FrameRing<ImageOf<PixelRgb> >::Slot *slots = ring.alloc(ringSize);
+    for (int i = 0; i < ringSize; i++)
+        slots[i].image.resize(bwidth, bheight);
+
+    // the fovea is cut from the center of the buffer.
+    if (ifovea > bwidth) ifovea = bwidth;
+    if (ifovea > bheight) ifovea = bheight;
+
+    // the tables are built once for the actual resolution and shared by all the formatters.
+    if (!trsf.allocLookupTables(iCub::logpolar::C2L, inecc, inang, bwidth, bheight, ioverlap)) {
+        fprintf(stderr, "ServerLogpolarFrameGrabber: Can't allocate the logpolar lookup tables\n");
+        poly.close();
+        mutex.post();
+        return false;
+    }
+    flogp.getFormatter().setTransform(&trsf);
 
     canDrop = !config.check("no_drop", "if present, use strict policy for sending data");
     addStamp = config.check("stamp", "if present, add timestamps to data");
@@ -148,6 +180,11 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     fstd.initProcessingMode(canDrop, addStamp, fgTimed);
     fstd.setProcessingSize(cwidth, cheight);
 
+    // the cartesian image is resampled by stripes.
+    const int nthreads = config.check("resample_threads", Value(2), "number of threads resampling the cartesian image").asInt();
+    stdWorkers = new iCub::logpolar::StripeWorkers(nthreads);
+    fstd.getFormatter().setWorkers(stdWorkers);
+
     string namelp = portname;
     namelp += "/logpolar";
     flogp.open(namelp.c_str());
@@ -159,6 +196,36 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     ffov.open(namefov.c_str());
     ffov.initProcessingMode(canDrop, addStamp, fgTimed);
     ffov.setProcessingSize(ifovea, ifovea);
+
+    // the combined stream, a single message per frame with a single envelope.
+    bundle = config.check("bundle", "if present, stream logpolar, fovea and geometry together");
+    if (bundle) {
+        // the mutex is held here, don't call getGeometry().
+        LogpolarGeometry g;
+        g.necc = inecc;
+        g.nang = inang;
+        g.fovea = ifovea;
+        g.overlap = ioverlap;
+        g.width = bwidth;
+        g.height = bheight;
+        string namebundle = portname;
+        namebundle += "/bundle";
+        fbundle.open(namebundle.c_str());
+        fbundle.initProcessingMode(canDrop, addStamp);
+        fbundle.setGeometry(g, &trsf);
+    }
+
+    // the formatters run on their own threads.
+    tstd.attach(&ring, &fstd);
+    tlogp.attach(&ring, &flogp);
+    tfov.attach(&ring, &ffov);
+    tstd.start();
+    tlogp.start();
+    tfov.start();
+    if (bundle) {
+        tbundle.attach(&ring, &fbundle);
+        tbundle.start();
+    }
     active = true;
 
     // LATER: help information about the device driver (to be completed).
@@ -192,6 +259,7 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     addUsage("[get] [nang]", "get the number of angles of a logpolar image");
     addUsage("[get] [fov]", "get the size of the fovea of a logpolar image");
     addUsage("[get] [ovl]", "get the overlap between receptive fields in the logpolar image");
+    addUsage("[get] [geom]", "get necc, nang, fovea, overlap and the width and height of the sampled image at once");
 
     // configure and start acquisition thread.
     double framerate = config.check("framerate",Value("0")).asDouble();
@@ -210,6 +278,10 @@ bool ServerLogpolarFrameGrabber::open(yarp::os::Searchable& config) {
     if (!RateThread::start()) {
         fprintf(stderr, "ServerLogpolarFrameGrabber: Troubles starting the grabber thread\n");
         // LATER: here I need to delete all objects, close ports, etc.
+        tstd.stop();
+        tlogp.stop();
+        tfov.stop();
+        if (bundle) tbundle.stop();
         active = false;
         mutex.post();
         return false;
@@ -230,39 +302,74 @@ bool ServerLogpolarFrameGrabber::close() {
     }
 
     active = false;
+    mutex.post();
+
+    // the acquisition thread takes the mutex, stop it (and the formatters) without holding it.
     RateThread::stop();
+    tstd.stop();
+    tlogp.stop();
+    tfov.stop();
+    if (bundle) tbundle.stop();
 
+    mutex.wait();
     fstd.close();
     flogp.close();
     ffov.close();
+    if (bundle) {
+        fbundle.close();
+        fbundle.setGeometry(LogpolarGeometry(), 0);
+    }
+    bundle = false;
 
     poly.close();
     fgImage = 0;
     fgCtrl = 0;
     fgTimed = 0;
 
+    flogp.getFormatter().setTransform(0);
+    trsf.freeLookupTables();
+    ring.free();
+
+    fstd.getFormatter().setWorkers(0);
+    if (stdWorkers) delete stdWorkers;
+    stdWorkers = 0;
+
     mutex.post();
     return true;
 }
 
 /*
- * implement the main thread loop.
- * LATER: no-multithread access at the moment (e.g. on rawBuffer).
+ * implement the main thread loop: acquire into a free buffer of the ring, publish it 
+ * and wake up the formatters. The mutex is held only while accessing the subdevice.
  */ 
 void ServerLogpolarFrameGrabber::run() {
+    FrameRing<ImageOf<PixelRgb> >::Slot *slot = ring.acquireWrite();
+    if (slot == 0)
+        return;
+
     mutex.wait();
 
     if (fgImage == 0) {
         mutex.post();
+        ring.release(slot);
         return;
     }
 
-    fgImage->getImage(buffer);
-    if (fstd.getOutputCount() > 0) fstd.process(buffer);
-    if (flogp.getOutputCount() > 0) flogp.process(buffer);
-    if (ffov.getOutputCount() > 0) ffov.process(buffer);
+    fgImage->getImage(slot->image);
+
+    // the time stamp is taken here, the formatters might run later.
+    if (fgTimed)
+        slot->stamp = fgTimed->getLastInputStamp();
+    else
+        slot->stamp.update();
 
     mutex.post();
+
+    ring.publish(slot);
+    tstd.notify();
+    tlogp.notify();
+    tfov.notify();
+    if (bundle) tbundle.notify();
 }
 
 /*
@@ -433,6 +540,21 @@ bool ServerLogpolarFrameGrabber::respond(const yarp::os::Bottle& cmd,
                 ok = true;
                 response.addDouble(overlap());
                 rec = true;
+                break;
+
+            // interface ILogpolarGeometry.
+            case VOCAB_GEOMETRY:
+                {
+                    LogpolarGeometry g;
+                    ok = getGeometry(g);
+                    response.addInt(g.necc);
+                    response.addInt(g.nang);
+                    response.addInt(g.fovea);
+                    response.addDouble(g.overlap);
+                    response.addInt(g.width);
+                    response.addInt(g.height);
+                    rec = true;
+                }
                 break;
 			}
 
@@ -611,11 +733,14 @@ bool ServerLogpolarFrameGrabber::respond(const yarp::os::Bottle& cmd,
  * implement the IFrameGrabberImage interface.
  */
 bool ServerLogpolarFrameGrabber::getImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) {
-    mutex.wait();
+    FrameRing<ImageOf<PixelRgb> >::Slot *slot = ring.acquireLatest();
+    if (slot == 0)
+        return false;
+
     StdImageFormatter fmt;
     image.resize (cwidth, cheight);
-    const bool ok = fmt.format(buffer, image);
-    mutex.post();
+    const bool ok = fmt.format(slot->image, image);
+    ring.release(slot);
     return ok;
 }
 
@@ -858,67 +983,269 @@ double ServerLogpolarFrameGrabber::overlap(void) const {
     return x;
 }
 
-bool ServerLogpolarFrameGrabber::getLogpolarImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) { 
+bool ServerLogpolarFrameGrabber::getGeometry(LogpolarGeometry& g) {
     mutex.wait();
+    g.necc = inecc;
+    g.nang = inang;
+    g.fovea = ifovea;
+    g.overlap = ioverlap;
+    g.width = bwidth;
+    g.height = bheight;
+    mutex.post();
+    return true;
+}
+
+bool ServerLogpolarFrameGrabber::getLogpolarImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) { 
+    FrameRing<ImageOf<PixelRgb> >::Slot *slot = ring.acquireLatest();
+    if (slot == 0)
+        return false;
+
     LogpolarImageFormatter fmt;
+    fmt.setTransform(&trsf);
     image.resize (inang, inecc);
-    const bool ok = fmt.format(buffer, image);
-    mutex.post();
+    const bool ok = fmt.format(slot->image, image);
+    ring.release(slot);
     return ok;
 }
 
 bool ServerLogpolarFrameGrabber::getFovealImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image) { 
-    mutex.wait();
+    FrameRing<ImageOf<PixelRgb> >::Slot *slot = ring.acquireLatest();
+    if (slot == 0)
+        return false;
+
     FovealImageFormatter fmt;
     image.resize (ifovea, ifovea);
-    const bool ok = fmt.format(buffer, image);
-    mutex.post();
+    const bool ok = fmt.format(slot->image, image);
+    ring.release(slot);
     return ok; 
 }
 
 /*
  * implement the image formatters.
  */
+/*
+ * the weights of the area filter are in fixed point, they add up to 1 << fixedShift.
+ */
+const int fixedShift = 14;
+const int fixedOne = 1 << fixedShift;
+
+// the vertical pass keeps 7 bits of fraction so that the horizontal pass fits in 32 bits.
+const int verticalShift = 7;
+const int horizontalShift = 2 * fixedShift - verticalShift;
+
+StdImageFormatter::StdImageFormatter() {
+    srcWidth = srcHeight = dstWidth = dstHeight = 0;
+    xTaps = yTaps = 0;
+    xStart = xCount = xWeight = 0;
+    yStart = yCount = yWeight = 0;
+    acc = 0;
+    nAcc = 0;
+    workers = 0;
+    src = 0;
+    dst = 0;
+}
+
+StdImageFormatter::~StdImageFormatter() {
+    freeCoefficients();
+}
+
+void StdImageFormatter::freeCoefficients() {
+    if (xStart) delete[] xStart;
+    if (xCount) delete[] xCount;
+    if (xWeight) delete[] xWeight;
+    if (yStart) delete[] yStart;
+    if (yCount) delete[] yCount;
+    if (yWeight) delete[] yWeight;
+    xStart = xCount = xWeight = 0;
+    yStart = yCount = yWeight = 0;
+
+    for (int i = 0; i < nAcc; i++)
+        delete[] acc[i];
+    if (acc) delete[] acc;
+    acc = 0;
+    nAcc = 0;
+
+    srcWidth = srcHeight = dstWidth = dstHeight = 0;
+}
+
+void StdImageFormatter::computeCoefficients(int in, int out, int& taps, int *&start, int *&count, int *&weight) {
+    const double scale = (double)in / (double)out;
+
+    // an output pixel covers at most ceil(scale)+1 input pixels.
+    taps = (int)ceil(scale) + 1;
+    start = new int[out];
+    count = new int[out];
+    weight = new int[out * taps];
+    memset(weight, 0, out * taps * sizeof(int));
+
+    for (int i = 0; i < out; i++) {
+        const double a = i * scale;
+        const double b = (i + 1) * scale;
+        int first = (int)floor(a);
+        int last = (int)ceil(b);
+        if (last > in) last = in;
+        if (first >= last) first = last - 1;
+
+        start[i] = first;
+        count[i] = last - first;
+
+        // the weight of an input pixel is the fraction of the output pixel it covers.
+        int *w = weight + i * taps;
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < count[i]; k++) {
+            const double lo = (first + k > a) ? first + k : a;
+            const double hi = (first + k + 1 < b) ? first + k + 1 : b;
+            const double f = (hi > lo) ? (hi - lo) / scale : 0.;
+            w[k] = (int)(f * fixedOne + .5);
+            sum += w[k];
+            if (w[k] > w[largest]) largest = k;
+        }
+
+        // the rounding error goes to the largest weight, the filter has unit gain.
+        w[largest] += fixedOne - sum;
+    }
+}
+
+void StdImageFormatter::processStripe(int stripe, int stripes) {
+    int first, last;
+    getStripe(dstHeight, stripe, stripes, first, last);
+
+    const int n = srcWidth * 3;
+    int *a = acc[stripe];
+
+    for (int y = first; y < last; y++) {
+        // vertical pass: a weighted sum of the input rows, contiguous and thus vectorizable.
+        const int *wy = yWeight + y * yTaps;
+        const unsigned char *row = src->getRow(yStart[y]);
+        int w = wy[0];
+        int i;
+        for (i = 0; i < n; i++)
+            a[i] = w * row[i];
+
+        for (int k = 1; k < yCount[y]; k++) {
+            row = src->getRow(yStart[y] + k);
+            w = wy[k];
+            for (i = 0; i < n; i++)
+                a[i] += w * row[i];
+        }
+
+        for (i = 0; i < n; i++)
+            a[i] = (a[i] + (1 << (verticalShift - 1))) >> verticalShift;
+
+        // horizontal pass on the interleaved rgb.
+        unsigned char *d = dst->getRow(y);
+        for (int x = 0; x < dstWidth; x++) {
+            const int *wx = xWeight + x * xTaps;
+            const int *s = a + xStart[x] * 3;
+            int r = 0, g = 0, b = 0;
+            for (int k = 0; k < xCount[x]; k++, s += 3) {
+                r += wx[k] * s[0];
+                g += wx[k] * s[1];
+                b += wx[k] * s[2];
+            }
+            *d++ = (unsigned char)((r + (1 << (horizontalShift - 1))) >> horizontalShift);
+            *d++ = (unsigned char)((g + (1 << (horizontalShift - 1))) >> horizontalShift);
+            *d++ = (unsigned char)((b + (1 << (horizontalShift - 1))) >> horizontalShift);
+        }
+    }
+}
+
 bool StdImageFormatter::format(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& buffer, 
                                yarp::sig::ImageOf<yarp::sig::PixelRgb>& formatted) {
     const int w = formatted.width();
     const int h = formatted.height();
 
-    // optimized for a common format 320x240 from 640x480 and no padding.
-    if (buffer.width() == 640 && buffer.height() == 480 &&
-        w == 320 && h == 240) {
-        for (int j = 0; j < h; j++) {
-            unsigned char *src = (unsigned char *)buffer.getRow(j*2);
-            unsigned char *dest = (unsigned char *)formatted.getRow(j);
-            for (int k = 0; k < w; k++, src+=3) {
-                *dest++ = *src++;
-                *dest++ = *src++;
-                *dest++ = *src++;
-            }
-        }
-    }
-    else if (buffer.width() == 640 && buffer.height() == 480 &&
-        w == 640 && h == 480) {
-            memcpy(formatted.getRawImage(), buffer.getRawImage(), buffer.getRawImageSize()); 
+    if (w <= 0 || h <= 0 || buffer.width() <= 0 || buffer.height() <= 0)
+        return false;
+
+    // same size, no filtering.
+    if (buffer.width() == w && buffer.height() == h) {
+        const int bytes = w * sizeof(PixelRgb);
+        for (int j = 0; j < h; j++)
+            memcpy(formatted.getRow(j), buffer.getRow(j), bytes);
+        return true;
     }
-    else {
-        // LATER: replace this with a proper filtering + subsampling.
-        formatted.copy(buffer, w, h);   // copy & resize.
+
+    // the coefficients are computed once for a given pair of sizes.
+    const int stripes = (workers != 0) ? workers->size() : 1;
+    if (buffer.width() != srcWidth || buffer.height() != srcHeight ||
+        w != dstWidth || h != dstHeight || stripes > nAcc) {
+        freeCoefficients();
+        computeCoefficients(buffer.width(), w, xTaps, xStart, xCount, xWeight);
+        computeCoefficients(buffer.height(), h, yTaps, yStart, yCount, yWeight);
+
+        nAcc = stripes;
+        acc = new int *[nAcc];
+        for (int i = 0; i < nAcc; i++)
+            acc[i] = new int[buffer.width() * 3];
+
+        srcWidth = buffer.width();
+        srcHeight = buffer.height();
+        dstWidth = w;
+        dstHeight = h;
     }
+
+    src = &buffer;
+    dst = &formatted;
+    if (workers != 0)
+        workers->run(*this);
+    else
+        processStripe(0, 1);
+    src = 0;
+    dst = 0;
+
     return true;
 }
 
-LogpolarImageFormatter::LogpolarImageFormatter() {
-    trsf.allocLookupTables(iCub::logpolar::C2L, nEcc, nAng, baseWidth, baseHeight, baseOverlap);
+bool LogpolarImageFormatter::format(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& buffer, 
+                                    yarp::sig::ImageOf<yarp::sig::PixelRgb>& formatted) {
+    // the tables are built for a given resolution of the buffer.
+    if (trsf == 0 || !trsf->allocated() || 
+        buffer.width() != trsf->width() || buffer.height() != trsf->height())
+        return false;
+    return trsf->cartToLogpolar(formatted, buffer);
 }
 
-LogpolarImageFormatter::~LogpolarImageFormatter() {
-    trsf.freeLookupTables();
+BundleFormatter::BundleFormatter() {
+    canDrop = false;
+    addStamp = true;
+    lpWidth = 0;
+    lpHeight = 0;
+    fovea = 0;
+    writer.attach(*this);
 }
 
-bool LogpolarImageFormatter::format(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& buffer, 
-                                    yarp::sig::ImageOf<yarp::sig::PixelRgb>& formatted) {
-    trsf.cartToLogpolar(formatted, (ImageOf<PixelRgb>&)buffer);
+void BundleFormatter::setGeometry(const LogpolarGeometry& g, iCub::logpolar::logpolarTransform *t) {
+    geometry.clear();
+    geometry.addInt(g.necc);
+    geometry.addInt(g.nang);
+    geometry.addInt(g.fovea);
+    geometry.addDouble(g.overlap);
+    geometry.addInt(g.width);
+    geometry.addInt(g.height);
+    lpWidth = g.nang;
+    lpHeight = g.necc;
+    fovea = g.fovea;
+    flogp.setTransform(t);
+}
+
+bool BundleFormatter::process(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& buffer, const yarp::os::Stamp& stamp) {
+    LogpolarBundle& datum = writer.get();
+    datum.head = geometry;
+    datum.body.head.resize(lpWidth, lpHeight);
+    datum.body.body.resize(fovea, fovea);
+
+    // both images come from the same buffer, or none is sent.
+    if (!flogp.format(buffer, datum.body.head) || !ffov.format(buffer, datum.body.body))
+        return false;
+
+    if (addStamp) {
+        yarp::os::Stamp envelope = stamp;
+        Port::setEnvelope(envelope);
+    }
+
+    writer.write(!canDrop);
     return true;
 }
 
@@ -930,8 +1257,11 @@ bool FovealImageFormatter::format(const yarp::sig::ImageOf<yarp::sig::PixelRgb>&
 bool FovealImageFormatter::subsampleFovea(yarp::sig::ImageOf<yarp::sig::PixelRgb>& dst, 
                                           const yarp::sig::ImageOf<yarp::sig::PixelRgb>& src) {
     const int fov = dst.width();
-    const int offset = baseHeight/2-fov/2;
-    const int col = baseWidth/2-fov/2;
+    if (fov > src.width() || fov > src.height())
+        return false;
+
+    const int offset = src.height()/2-fov/2;
+    const int col = src.width()/2-fov/2;
     const int bytes = fov*sizeof(PixelRgb);
 
     int i;
@@ -44,6 +44,8 @@
 #include <yarp/os/Vocab.h>
 #include <yarp/os/Bottle.h>
 #include <yarp/os/Semaphore.h>
+#include <yarp/os/Thread.h>
+#include <yarp/os/Stamp.h>
 
 /* dev drivers */
 #include <yarp/dev/FrameGrabberInterfaces.h>
@@ -52,6 +54,7 @@
 /* logpolar library */
 #include <iCub/logpolar/LogpolarInterfaces.h>
 #include <iCub/logpolar/RC_DIST_FB_logpolar_mapper.h>
+#include <iCub/logpolar/StripeWorkers.h>
 
 namespace yarp {
     namespace dev {
@@ -61,6 +64,9 @@ namespace yarp {
         class StdImageFormatter;
         class LogpolarImageFormatter;
         class FovealImageFormatter;
+        class BundleFormatter;
+        template <class T> class FrameRing;
+        template <class P> class FormatterThread;
     }
 }
 
@@ -87,9 +93,72 @@ public:
  * @ingroup logpolar
  *
  * Customization to the standard image formatter to provide a rectangular subsampled image.
+ * The image is resampled at any ratio by a separable area (box) filter in fixed point. The
+ * coefficients are computed once for a given pair of input and output sizes; the rows of
+ * the output image can be split in stripes processed concurrently.
  */
-class yarp::dev::StdImageFormatter : public yarp::dev::BaseFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb> > {
+class yarp::dev::StdImageFormatter : public yarp::dev::BaseFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb> >,
+                                     public iCub::logpolar::StripeJob {
+private:
+    StdImageFormatter(const StdImageFormatter&);
+    void operator=(const StdImageFormatter&);
+
+protected:
+    // the precomputed filter coefficients, for each output column (row): first input column (row), 
+    // number of taps and their weights (taps per output pixel).
+    int srcWidth, srcHeight, dstWidth, dstHeight;
+    int xTaps, yTaps;
+    int *xStart, *xCount, *xWeight;
+    int *yStart, *yCount, *yWeight;
+
+    // the accumulators of the vertical pass (one row per stripe).
+    int **acc;
+    int nAcc;
+
+    iCub::logpolar::StripeWorkers *workers;
+    const yarp::sig::ImageOf<yarp::sig::PixelRgb> *src;
+    yarp::sig::ImageOf<yarp::sig::PixelRgb> *dst;
+
+    /**
+     * Compute the coefficients of the area filter along one dimension.
+     * @param in is the input size.
+     * @param out is the output size.
+     * @param taps is the maximum number of taps per output pixel.
+     * @param start is filled with the first input pixel of each output pixel.
+     * @param count is filled with the number of input pixels of each output pixel.
+     * @param weight is filled with the weights (in fixed point, adding up to one).
+     */
+    void computeCoefficients(int in, int out, int& taps, int *&start, int *&count, int *&weight);
+
+    /**
+     * Free the coefficients and the accumulators.
+     */
+    void freeCoefficients();
+
 public:
+    /**
+     * Constructor.
+     */
+    StdImageFormatter();
+
+    /**
+     * Destructor.
+     */
+    virtual ~StdImageFormatter();
+
+    /**
+     * Set the threads running the stripes of the resampling.
+     * @param w is a pool of threads (0 to run on the calling thread only).
+     */
+    void setWorkers(iCub::logpolar::StripeWorkers *w) { workers = w; }
+
+    /**
+     * Resample a stripe of rows of the output image (called concurrently by the workers).
+     * @param stripe is the index of the stripe.
+     * @param stripes is the total number of stripes.
+     */
+    virtual void processStripe(int stripe, int stripes);
+
     /**
      * The format method takes a raw buffer image and formats according to the
      * code provided in the format method.
@@ -106,14 +175,22 @@ public:
  * @ingroup logpolar
  *
  * Customization of the standard image formatter to provide a logpolar subsampled image output.
+ * The lookup tables are not owned by the formatter, they are built once by the server and shared
+ * by all the formatters.
  */
 class yarp::dev::LogpolarImageFormatter : public yarp::dev::BaseFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb> > {
 protected:
-    iCub::logpolar::logpolarTransform trsf;
+    iCub::logpolar::logpolarTransform *trsf;
 
 public:
-    LogpolarImageFormatter();
-    virtual ~LogpolarImageFormatter();
+    LogpolarImageFormatter() : trsf(0) {}
+
+    /**
+     * Set the lookup tables used by the formatter.
+     * @param t is a pointer to the logpolarTransform object with the C2L tables allocated 
+     * for the size of the raw buffer.
+     */
+    void setTransform(iCub::logpolar::logpolarTransform *t) { trsf = t; }
 
     /**
      * The format method takes a raw buffer image and formats according to the
@@ -156,6 +233,72 @@ public:
                                 const yarp::sig::ImageOf<yarp::sig::PixelRgb>& src);
 };
 
+/**
+ * @ingroup logpolar
+ *
+ * The formatter of the combined stream: the logpolar image and the fovea are formatted from 
+ * the same buffer and written as one LogpolarBundle message, together with the geometry and 
+ * under a single envelope. It shares the lookup tables of the logpolar formatter.
+ */
+class yarp::dev::BundleFormatter : public yarp::os::Port {
+private:
+    BundleFormatter(const BundleFormatter&);
+    void operator=(const BundleFormatter&);
+
+protected:
+    yarp::os::PortWriterBuffer<LogpolarBundle> writer;
+    LogpolarImageFormatter flogp;
+    FovealImageFormatter ffov;
+    yarp::os::Bottle geometry;
+    int lpWidth;
+    int lpHeight;
+    int fovea;
+
+    bool canDrop;
+    bool addStamp;
+
+public:
+    /**
+     * Constructor.
+     */
+    BundleFormatter();
+
+    /**
+     * Destructor, close the internal Port object.
+     */
+    virtual ~BundleFormatter() {
+        yarp::os::Port::close();
+    }
+
+    /**
+     * Prepare the port to processing.
+     * @param drp indicates whether packets can be dropped (strict protocol).
+     * @param stamp indicates whether time stamps should be added to the messages.
+     * @return always true.
+     */
+    bool initProcessingMode(bool drp, bool stamp) {
+        canDrop = drp;
+        addStamp = stamp;
+        return true;
+    }
+
+    /**
+     * Set the geometry of the bundle and the lookup tables used to sample the logpolar image.
+     * @param g is the geometry, sent along with each bundle.
+     * @param t is a pointer to the logpolarTransform object with the C2L tables allocated 
+     * for the size of the raw buffer (0 to detach the tables).
+     */
+    void setGeometry(const LogpolarGeometry& g, iCub::logpolar::logpolarTransform *t);
+
+    /**
+     * Format the logpolar image and the fovea and send them across the network.
+     * @param buffer is the raw input buffer.
+     * @param stamp is the time stamp of the buffer, taken when the buffer was acquired.
+     * @return true iff the call is successful.
+     */
+    bool process(const yarp::sig::ImageOf<yarp::sig::PixelRgb>& buffer, const yarp::os::Stamp& stamp);
+};
+
 /**
  * @ingroup logpolar
  *
@@ -218,6 +361,12 @@ public:
         return true;
     }
 
+    /**
+     * Get the formatter, e.g. to share resources among formatters.
+     * @return a reference to the formatter object.
+     */
+    F& getFormatter() { return fmt; }
+
     /**
      * Destructor, close the internal Port object.
      */
@@ -234,20 +383,33 @@ public:
      */
     virtual bool process(const T& buffer) {
         yarp::os::Stamp stamp;
+        if (pPrecTime)
+        {
+            stamp = pPrecTime->getLastInputStamp();
+        }
+        else
+        {
+            stamp.update();
+        }
+        return process(buffer, stamp);
+    }
+
+    /**
+     * This method calls format to process the image buffer and then 
+     * sends the result across the network using the internal Port object.
+     *
+     * @param buffer is the raw input buffer, e.g. bayer pattern image.
+     * @param stamp is the time stamp of the buffer, taken when the buffer was acquired.
+     * @return true iff the call is successful.
+     */
+    virtual bool process(const T& buffer, const yarp::os::Stamp& stamp) {
         T& datum = writer.get();
         datum.resize(width, height);
         bool ok = fmt.format(buffer, datum);
         if (ok) {
             if (addStamp) {
-			    if (pPrecTime)
-			    {
-				    stamp = pPrecTime->getLastInputStamp();
-			    }
-			    else
-			    {
-				    stamp.update();
-			    }
-                Port::setEnvelope(stamp);
+                yarp::os::Stamp envelope = stamp;
+                Port::setEnvelope(envelope);
             }
 
             writer.write(!canDrop);
@@ -258,6 +420,196 @@ public:
     }
 };
 
+/**
+ * @ingroup logpolar
+ *
+ * A ring of image buffers shared by the acquisition thread (a single producer) and
+ * the formatters (the consumers). The producer fills a buffer nobody is reading and 
+ * publishes it as the latest; consumers hold a reference to the buffer they are 
+ * formatting. The lock only protects the bookkeeping of the ring, images are never 
+ * copied nor processed while holding it. With at least two buffers more than the 
+ * consumers the producer always finds a free buffer.
+ */
+template <class T>
+class yarp::dev::FrameRing {
+public:
+    /**
+     * A buffer of the ring.
+     */
+    struct Slot {
+        T image;                    // the acquired image
+        yarp::os::Stamp stamp;      // the time stamp taken at acquisition
+        int seq;                    // the sequence number of the image
+        int refs;                   // the number of readers (and the writer)
+    };
+
+private:
+    FrameRing(const FrameRing&);
+    void operator=(const FrameRing&);
+
+    Slot *slots;
+    int n;
+    int latest;
+    int seq;
+    yarp::os::Semaphore mutex;
+
+public:
+    /**
+     * Constructor.
+     */
+    FrameRing() : slots(0), n(0), latest(-1), seq(0), mutex(1) {}
+
+    /**
+     * Destructor.
+     */
+    ~FrameRing() { free(); }
+
+    /**
+     * Allocate the buffers.
+     * @param size is the number of buffers (number of consumers + 2).
+     * @return a pointer to the first buffer (e.g. to size the images).
+     */
+    Slot *alloc(int size) {
+        free();
+        n = size;
+        slots = new Slot[n];
+        for (int i = 0; i < n; i++) {
+            slots[i].seq = -1;
+            slots[i].refs = 0;
+        }
+        latest = -1;
+        seq = 0;
+        return slots;
+    }
+
+    /**
+     * Free the buffers (nobody must be holding them).
+     */
+    void free() {
+        if (slots) delete[] slots;
+        slots = 0;
+        n = 0;
+        latest = -1;
+    }
+
+    /**
+     * Get a buffer to acquire into, i.e. a buffer that is neither being read nor the latest.
+     * @return the buffer or 0 if none is available.
+     */
+    Slot *acquireWrite() {
+        Slot *s = 0;
+        mutex.wait();
+        for (int i = 0; i < n; i++) {
+            if (slots[i].refs == 0 && i != latest) {
+                s = &slots[i];
+                s->refs = 1;
+                break;
+            }
+        }
+        mutex.post();
+        return s;
+    }
+
+    /**
+     * Publish the buffer acquired into as the latest image.
+     * @param s is the buffer obtained from acquireWrite().
+     */
+    void publish(Slot *s) {
+        mutex.wait();
+        s->seq = seq++;
+        s->refs--;
+        latest = (int)(s - slots);
+        mutex.post();
+    }
+
+    /**
+     * Get a reference to the latest image, if newer than a given one.
+     * @param last is the sequence number of the last image read (-1 to get any image).
+     * @return the buffer or 0 if no newer image is available.
+     */
+    Slot *acquireLatest(int last = -1) {
+        Slot *s = 0;
+        mutex.wait();
+        if (latest >= 0 && slots[latest].seq != last) {
+            s = &slots[latest];
+            s->refs++;
+        }
+        mutex.post();
+        return s;
+    }
+
+    /**
+     * Release a buffer obtained from acquireLatest().
+     * @param s is the buffer.
+     */
+    void release(Slot *s) {
+        mutex.wait();
+        s->refs--;
+        mutex.post();
+    }
+};
+
+/**
+ * @ingroup logpolar
+ *
+ * A thread running an ImageFormatter on the latest image of a FrameRing. Each formatter runs 
+ * on its own thread, thus a slow formatter or a slow network write neither stalls the 
+ * acquisition nor the other formatters (the formatter simply skips to the latest image).
+ */
+template <class P>
+class yarp::dev::FormatterThread : public yarp::os::Thread {
+private:
+    FormatterThread(const FormatterThread&);
+    void operator=(const FormatterThread&);
+
+    FrameRing<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *ring;
+    P *formatter;
+    yarp::os::Semaphore ready;
+    int last;
+
+public:
+    /**
+     * Constructor.
+     */
+    FormatterThread() : ring(0), formatter(0), ready(0), last(-1) {}
+
+    /**
+     * Connect the thread to the ring and the formatter.
+     * @param r is the ring of acquired images.
+     * @param f is the formatter (and port).
+     */
+    void attach(FrameRing<yarp::sig::ImageOf<yarp::sig::PixelRgb> > *r, P *f) {
+        ring = r;
+        formatter = f;
+    }
+
+    /**
+     * Signal a new image in the ring (called by the acquisition thread).
+     */
+    void notify() { ready.post(); }
+
+    virtual void run() {
+        while (!isStopping()) {
+            ready.wait();
+            if (isStopping())
+                break;
+
+            typename FrameRing<yarp::sig::ImageOf<yarp::sig::PixelRgb> >::Slot *s = ring->acquireLatest(last);
+            if (s == 0)
+                continue;
+
+            last = s->seq;
+            if (formatter->getOutputCount() > 0) 
+                formatter->process(s->image, s->stamp);
+            ring->release(s);
+        }
+    }
+
+    virtual void onStop() {
+        ready.post();
+    }
+};
+
 
 /**
  * @ingroup logpolar
@@ -270,7 +622,8 @@ public:
  * The network interface is on multiple Ports (logpolar and foveal).
  * Images are streamed out from those Ports -- RemoteFrameGrabber
  * uses these streams to provide the IFrameGrabberImage/ILogpolarFrameGrabberImage 
- * interfaces.
+ * interfaces. Optionally, the logpolar image and the fovea of the same frame are 
+ * also streamed together from a single port (name/bundle) as a LogpolarBundle.
  * The IFrameGrabberControls and ILogpolarFrameGrabberControls functionality are 
  * provided via RPC.
  *
@@ -302,6 +655,7 @@ public:
  * <TR><TD> [get] [bri] </TD><TD> [is] [bri] 1.0 </TD><TD> getBrightness() </TD></TR>
  * <TR><TD> [get] [gain] </TD><TD> [is] [gain] 1.0 </TD><TD> getGain() </TD></TR>
  * <TR><TD> [get] [shut] </TD><TD> [is] [shut] 1.0 </TD><TD> getShutter() </TD></TR>
+ * <TR><TD> [get] [geom] </TD><TD> [is] [geom] 152 252 128 1.0 640 480 </TD><TD> getGeometry() </TD></TR>
  * </TABLE>
  *
  */
@@ -309,6 +663,7 @@ class yarp::dev::ServerLogpolarFrameGrabber : public DeviceDriver,
                 public DeviceResponder,
                 public IFrameGrabberImage,
                 public ILogpolarFrameGrabberImage,
+                public ILogpolarGeometry,
                 public IFrameGrabberControls,
                 public IService,
                 public yarp::os::RateThread
@@ -326,16 +681,27 @@ protected:
     ImageFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::dev::LogpolarImageFormatter> flogp;
     ImageFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::dev::FovealImageFormatter> ffov;
 
+    // each formatter runs on its own thread.
+    FormatterThread<ImageFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::dev::StdImageFormatter> > tstd;
+    FormatterThread<ImageFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::dev::LogpolarImageFormatter> > tlogp;
+    FormatterThread<ImageFormatter<yarp::sig::ImageOf<yarp::sig::PixelRgb>, yarp::dev::FovealImageFormatter> > tfov;
+
+    // the optional combined stream (logpolar, fovea and geometry in one message).
+    BundleFormatter fbundle;
+    FormatterThread<BundleFormatter> tbundle;
+    bool bundle;
+
     PolyDriver poly;
     IFrameGrabberImage *fgImage;
     IFrameGrabberControls *fgCtrl;
     IPreciselyTimed *fgTimed;
 
+    // protects the access to the subdevice (acquisition and controls).
     yarp::os::Semaphore mutex;
 
-    // keep one copy of the image buffer and provide various "views" of it depending on 
-    // the request (std image, logpolar, foveal).
-    yarp::sig::ImageOf<yarp::sig::PixelRgb> buffer;
+    // a ring of image buffers, the acquisition thread fills them and the formatters provide various 
+    // "views" of the latest one depending on the request (std image, logpolar, foveal).
+    FrameRing<yarp::sig::ImageOf<yarp::sig::PixelRgb> > ring;
 
     // cartesian output image specs.
     int cwidth;
@@ -347,6 +713,16 @@ protected:
     int ifovea;
     double ioverlap;
 
+    // size of the acquired buffer (the logpolar image is sampled from it).
+    int bwidth;
+    int bheight;
+
+    // the lookup tables, built once at open for the actual size of the buffer and shared by the formatters.
+    iCub::logpolar::logpolarTransform trsf;
+
+    // the threads resampling the cartesian image.
+    iCub::logpolar::StripeWorkers *stdWorkers;
+
     bool canDrop;
     bool addStamp;
     bool active;
@@ -365,7 +741,16 @@ public:
      * <TR><TD> width </TD><TD> Width of the cartesian output image. </TD></TR>
      * <TR><TD> height </TD><TD> Height of the cartesian output image. </TD></TR>
      * <TR><TD> framerate </TD><TD> Period of the acquisition thread (e.g. 33ms). </TD></TR>
+     * <TR><TD> sensor_width </TD><TD> Width requested to the subdevice (default 640). </TD></TR>
+     * <TR><TD> sensor_height </TD><TD> Height requested to the subdevice (default 480). </TD></TR>
+     * <TR><TD> necc </TD><TD> Number of eccentricities of the logpolar image (default 152). </TD></TR>
+     * <TR><TD> nang </TD><TD> Number of angles of the logpolar image (default 252). </TD></TR>
+     * <TR><TD> fovea </TD><TD> Size of the foveal image (default 128). </TD></TR>
+     * <TR><TD> overlap </TD><TD> Overlap of the receptive fields (default 1.0). </TD></TR>
+     * <TR><TD> resample_threads </TD><TD> Number of threads resampling the cartesian image (default 2). </TD></TR>
+     * <TR><TD> bundle </TD><TD> If present, stream the logpolar image, the fovea and the geometry together on name/bundle. </TD></TR>
      * </TABLE>
+     * The logpolar tables are built for the resolution actually provided by the subdevice.
      *
      * @param config The options to use
      * @return true iff the object could be configured.
@@ -589,6 +974,15 @@ public:
      */
     virtual bool getLogpolarImage(yarp::sig::ImageOf<yarp::sig::PixelRgb>& image);
 
+    // implementation of the ILogpolarGeometry interface.
+
+    /**
+     * Get the whole geometry of the logpolar images at once.
+     * @param g is filled with the geometry.
+     * @return true iff successful.
+     */
+    virtual bool getGeometry(LogpolarGeometry& g);
+
     /**
      * Get the foveal image (a small part of the centre of the image in full resolution).
      * @param image is the RGB image containing the foveal image.